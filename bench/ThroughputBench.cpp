@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <pthread.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <vector>
+#include <zlib.h>
+
+#include "ApiClient.hpp"
+#include "Async.hpp"
+#include "KeyPool.hpp"
+#include "Metrics.hpp"
+#include "RateLimiter.hpp"
+#include "ThreadManager.hpp"
+#include "Transport.hpp"
+#include "dependencies/httplib.h"
+
+/*
+ * Throughput of one busy ethereum target against a local mock of etherscan and chainalysis.
+ * Every round the mock target receives TXS_PER_ROUND new transactions, so a poll has to page back
+ * TXS_PER_ROUND / 10 pages and screen one fresh counterparty per transaction.
+ */
+
+static const int MOCK_LATENCY_MS = 5;
+static const int TXS_PER_ROUND = 100;
+static const int ROUNDS = 5;
+static const size_t MOCK_GZIP_MIN_BYTES = 1024;
+
+class MockProvider {
+public:
+    explicit MockProvider(int port) : port(port) {
+        server.new_task_queue = [] { return new httplib::ThreadPool(64); };
+        server.Get("/api", [this](const httplib::Request& req, httplib::Response& res) {
+            requests++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(MOCK_LATENCY_MS));
+            std::string target = req.get_param_value("address");
+            long long head = headOf(target);
+            if (req.get_param_value("action") == "balance") {
+                reply(req, res, R"({"status":"1","message":"OK","result":")" + std::to_string(head) + R"("})");
+                return;
+            }
+            long long page = std::stoll(req.get_param_value("page"));
+            long long offset = std::stoll(req.get_param_value("offset"));
+            long long start = req.has_param("startblock") ? std::stoll(req.get_param_value("startblock")) : 0;
+            std::ostringstream body;
+            body << R"({"status":"1","message":"OK","result":[)";
+            for (long long i = head - 1 - (page - 1) * offset, n = 0; i >= 0 && i + 1 >= start && n < offset; --i, ++n) {
+                if (n) body << ",";
+                body << R"({"blockNumber":")" << (i + 1) << R"(","hash":")" << hex(target, i, 64)
+                     << R"(","from":")" << target << R"(","to":")" << hex(target, i, 40)
+                     << R"(","value":"1","input":"0xa9059cbb000000000000000000000000)" << hex(target, -i, 40).substr(2)
+                     << std::string(48, '0') << hex(target, i, 16).substr(2) << R"("})";
+            }
+            body << "]}";
+            reply(req, res, body.str());
+        });
+        server.Get(R"(/api/v1/address/(.+))", [this](const httplib::Request& req, httplib::Response& res) {
+            requests++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(MOCK_LATENCY_MS));
+            reply(req, res, R"({"identifications":[]})");
+        });
+        /* providers answer in one go; without this the mock's split writes wait out the client's delayed ack */
+        server.set_tcp_nodelay(true);
+        server.set_socket_options([this](socket_t sock) {
+            httplib::default_socket_options(sock);
+            listening = sock;
+        });
+        thread = std::thread([this]() { server.listen("127.0.0.1", this->port); });
+        server.wait_until_ready();
+        /* httplib listens with a backlog of 5; a provider's accept queue is far deeper than a burst of connects */
+        ::listen(listening, SOMAXCONN);
+    }
+
+    ~MockProvider() {
+        server.stop();
+        thread.join();
+    }
+
+    void addTransactions(const std::string& target, long long count) {
+        std::lock_guard<std::mutex> lock(mutex);
+        heads[target] += count;
+    }
+
+    std::string url() const {
+        return "http://127.0.0.1:" + std::to_string(port);
+    }
+
+    std::atomic<long long> requests{0};
+
+private:
+    /* like the providers, bodies too small to gain from it go out uncompressed */
+    static void reply(const httplib::Request& req, httplib::Response& res, const std::string& body) {
+        if (body.size() < MOCK_GZIP_MIN_BYTES || std::string::npos == req.get_header_value("Accept-Encoding").find("gzip")) {
+            res.set_content(body, "application/json");
+            return;
+        }
+        z_stream zlib{};
+        deflateInit2(&zlib, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+        std::string compressed(deflateBound(&zlib, body.size()), '\0');
+        zlib.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(body.data()));
+        zlib.avail_in = static_cast<uInt>(body.size());
+        zlib.next_out = reinterpret_cast<Bytef*>(&compressed[0]);
+        zlib.avail_out = static_cast<uInt>(compressed.size());
+        deflate(&zlib, Z_FINISH);
+        compressed.resize(zlib.total_out);
+        deflateEnd(&zlib);
+        res.set_header("Content-Encoding", "gzip");
+        res.set_content(compressed, "application/json");
+    }
+
+    long long headOf(const std::string& target) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return heads[target];
+    }
+
+    static std::string hex(const std::string& seed, long long i, size_t digits) {
+        std::string out = "0x";
+        unsigned long long h = std::hash<std::string>{}(seed) ^ static_cast<unsigned long long>(i);
+        while (out.length() < digits + 2) {
+            h = h * 6364136223846793005ULL + 1442695040888963407ULL;
+            char chunk[17];
+            std::snprintf(chunk, sizeof(chunk), "%016llx", h);
+            out += chunk;
+        }
+        return out.substr(0, digits + 2);
+    }
+
+    int port;
+    socket_t listening = -1;
+    httplib::Server server;
+    std::thread thread;
+    std::mutex mutex;
+    std::map<std::string, long long> heads;
+};
+
+#ifdef NETZ_COROUTINES
+static Async<std::string> pollOnLoop(ApiClient& client, EventLoop& loop) {
+    std::string result = co_await client.fetchTransactions(loop);
+    if (std::to_string(ApiClient::OK) != result) co_return result;
+    co_return co_await client.screenCounterparties(loop);
+}
+#endif
+
+int main(int argc, char* argv[]) {
+    int maxThreads = argc > 1 ? std::atoi(argv[1]) : 8;
+#ifdef NETZ_HTTP2
+    /* the mock only speaks http/1.1, so this measures libcurl's pooling rather than multiplexing */
+    if (argc > 2 && std::string("http2") == argv[2]) ApiClient::setTransport(std::make_shared<CurlTransport>());
+#endif
+    KeyPool::add("etherscan", "bench");
+    KeyPool::add("chainalysis", "bench");
+    for (const char* provider : {"etherscan", "trongrid", "shyft", "chainalysis"}) {
+        RateLimiter::setKeyRate(provider, 1000000);
+    }
+
+    MockProvider mock(18545);
+    ApiClient::URLs urls;
+    urls.etherscan_url = mock.url();
+    urls.chainalysis_url = mock.url();
+
+    std::streambuf* console = std::cout.rdbuf();
+    std::ostringstream discard;
+    std::printf("%8s %12s %12s %10s\n", "threads", "requests/s", "txs/s", "speedup");
+    double baseline = 0;
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        std::string target = "0x" + std::string(39, '0') + std::to_string(threads % 10);
+        auto queue = std::make_shared<WorkQueue>();
+        std::vector<std::thread> workers;
+        for (int i = 0; i < threads; ++i) {
+            workers.emplace_back([queue]() { ThreadManager::runWorkerThread(*queue); });
+        }
+        ApiClient client(target, urls);
+        client.setWorkQueue(queue);
+        MillisecondClock clock;
+        clock.start();
+
+        std::cout.rdbuf(discard.rdbuf());
+        auto poll = [&]() {
+            auto done = queue->submit([&]() { ThreadManager::pollNetwork(client, "ethereum", false, clock); });
+            done.get();
+            discard.str("");
+        };
+        mock.addTransactions(target, 10);
+        poll();
+
+        long long requests_before = mock.requests.load();
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round < ROUNDS; ++round) {
+            mock.addTransactions(target, TXS_PER_ROUND);
+            poll();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout.rdbuf(console);
+
+        double rate = (mock.requests.load() - requests_before) / seconds;
+        if (1 == threads) baseline = rate;
+        std::printf("%8d %12.1f %12.1f %9.2fx\n", threads, rate, ROUNDS * TXS_PER_ROUND / seconds, rate / baseline);
+
+        queue->shutdown();
+        for (auto& worker : workers) worker.join();
+    }
+#ifdef NETZ_COROUTINES
+    /* the same rounds as coroutines on a single event loop thread, with no workers at all */
+    {
+        std::string target = "0x" + std::string(39, '0') + "e";
+        EventLoop loop;
+        std::thread runner([&loop]() { loop.run(); });
+        ApiClient client(target, urls);
+
+        std::cout.rdbuf(discard.rdbuf());
+        auto poll = [&]() {
+            std::promise<void> done;
+            Async<std::string>::start(pollOnLoop(client, loop), [&done](std::string) { done.set_value(); },
+                                      [&done](std::exception_ptr error) { done.set_exception(error); });
+            done.get_future().get();
+            discard.str("");
+        };
+        mock.addTransactions(target, 10);
+        poll();
+
+        /* cpu of the loop thread alone, the mock shares the process */
+        clockid_t loop_clock;
+        pthread_getcpuclockid(runner.native_handle(), &loop_clock);
+        timespec cpu_before{};
+        clock_gettime(loop_clock, &cpu_before);
+        long long requests_before = mock.requests.load();
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round < ROUNDS; ++round) {
+            mock.addTransactions(target, TXS_PER_ROUND);
+            poll();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        timespec cpu_after{};
+        clock_gettime(loop_clock, &cpu_after);
+        std::cout.rdbuf(console);
+
+        long long requests = mock.requests.load() - requests_before;
+        double rate = requests / seconds;
+        double cpu = (cpu_after.tv_sec - cpu_before.tv_sec) + (cpu_after.tv_nsec - cpu_before.tv_nsec) / 1e9;
+        std::printf("%8s %12.1f %12.1f %9.2fx\n", "loop", rate, ROUNDS * TXS_PER_ROUND / seconds, rate / baseline);
+        std::printf("%8s %.1f us of loop thread cpu per request over %s\n", "", cpu * 1e6 / requests, loop.backend());
+
+        loop.stop();
+        runner.join();
+    }
+#endif
+    /* both providers share the mock's url, so the metrics count all of it under the first */
+    Metrics::Counters& metrics = Metrics::get("etherscan");
+    std::printf("%lld response bytes on the wire for %lld decoded (%.0f%% saved), %.1f us decoding per request\n",
+                metrics.wireBytes.load(), metrics.responseBytes.load(),
+                100.0 - 100.0 * metrics.wireBytes / std::max(1LL, metrics.responseBytes.load()),
+                static_cast<double>(metrics.decodeMicros) / std::max(1LL, metrics.requests.load()));
+    return 0;
+}
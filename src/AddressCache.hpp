@@ -3,6 +3,7 @@
 #define ADDRESS_CACHE_HPP
 
 #include <list>
+#include <stdexcept>
 #include <unordered_map>
 
 template<typename K, typename V>
@@ -10,7 +11,7 @@ class AddressCache {
 public: 
     explicit AddressCache(size_t capacity) : capacity(capacity) {}
 
-    V& get(const K& key) {
+    V get(const K& key) {
         auto map_it = cache_map.find(key);
         if (map_it == cache_map.end()) {
             throw std::runtime_error("Key not found in cache");
@@ -42,6 +43,14 @@ public:
         return cache_map.find(key) != cache_map.end();
     }
 
+    // visit entries from most to least recently used until fn returns false, without touching their order
+    template<typename F>
+    void forEach(F fn) const {
+        for (const auto& [key, value] : cache_list) {
+            if (!fn(key, value)) return;
+        }
+    }
+
     size_t size() const {
         return cache_list.size();
     }
@@ -0,0 +1,73 @@
+#include <array>
+
+#include "AddressValidator.hpp"
+
+namespace {
+
+enum CharClass : unsigned char { HEX = 1, BASE58 = 2 };
+
+/* one lookup per character instead of a search through an alphabet string */
+constexpr std::array<unsigned char, 256> buildCharClasses() {
+    std::array<unsigned char, 256> table{};
+    const char hex[] = "0123456789abcdefABCDEF";
+    const char base58[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+    for (const char* c = hex; *c; ++c) table[static_cast<unsigned char>(*c)] |= HEX;
+    for (const char* c = base58; *c; ++c) table[static_cast<unsigned char>(*c)] |= BASE58;
+    return table;
+}
+
+constexpr std::array<unsigned char, 256> CHAR_CLASSES = buildCharClasses();
+
+bool allOf(std::string_view text, CharClass cls) {
+    for (char c : text) {
+        if (!(CHAR_CLASSES[static_cast<unsigned char>(c)] & cls)) return false;
+    }
+    return true;
+}
+
+const std::string ETHEREUM = "ethereum";
+const std::string TRON = "tron";
+const std::string SOLANA = "solana";
+const std::string UNKNOWN = "";
+
+bool equalsIgnoreCase(std::string_view a, const std::string& b) {
+    if (a.length() != b.length()) return false;
+    for (size_t i = 0; i < a.length(); ++i) {
+        char c = a[i];
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+        if (c != b[i]) return false;
+    }
+    return true;
+}
+
+}
+
+const std::string& AddressValidator::canonicalNetwork(std::string_view network) {
+    if (equalsIgnoreCase(network, ETHEREUM)) return ETHEREUM;
+    if (equalsIgnoreCase(network, TRON)) return TRON;
+    if (equalsIgnoreCase(network, SOLANA)) return SOLANA;
+    return UNKNOWN;
+}
+
+bool AddressValidator::isValid(std::string_view network, std::string_view address) {
+    if (network == ETHEREUM) {
+        return 42 == address.length() && address[0] == '0' && address[1] == 'x' && allOf(address.substr(2), HEX);
+    }
+    if (network == TRON) {
+        return 34 == address.length() && address[0] == 'T' && allOf(address, BASE58);
+    }
+    if (network == SOLANA) {
+        return 32 <= address.length() && 44 >= address.length() && allOf(address, BASE58);
+    }
+    return false;
+}
+
+std::string AddressValidator::canonicalAddress(std::string_view network, std::string_view address) {
+    std::string canonical(address);
+    if (network == ETHEREUM) {
+        for (char& c : canonical) {
+            if (c >= 'A' && c <= 'F') c = static_cast<char>(c - 'A' + 'a');
+        }
+    }
+    return canonical;
+}
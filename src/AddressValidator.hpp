@@ -0,0 +1,20 @@
+#pragma once
+#ifndef ADDRESS_VALIDATOR_HPP
+#define ADDRESS_VALIDATOR_HPP
+
+#include <string>
+#include <string_view>
+
+class AddressValidator {
+public:
+    // canonical network name for any spelling of a supported network, empty if unsupported
+    static const std::string& canonicalNetwork(std::string_view network);
+
+    // format check against a canonical network name
+    static bool isValid(std::string_view network, std::string_view address);
+
+    // ethereum hex is case-insensitive and gets lowercased, base58 networks are kept as given
+    static std::string canonicalAddress(std::string_view network, std::string_view address);
+};
+
+#endif
@@ -1,119 +1,640 @@
 #include "ApiClient.hpp"
+#include "Hedging.hpp"
+#include "KeyPool.hpp"
+#include "Metrics.hpp"
+#include "OutputSink.hpp"
+#include <chrono>
 #include <cstdlib>
+#include <future>
 #include <iomanip>
 #include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
 
 const static std::string SANCTIONS = "sanctions";
 
-ApiClient::ApiClient(const std::string& target) : target(target) {
+SingleFlight<std::string, std::shared_ptr<const httplib::Result>> ApiClient::in_flight;
+
+std::shared_ptr<Transport> ApiClient::transport = std::make_shared<HttplibTransport>();
+
+size_t ApiClient::dedupe_window = 10000;
+std::shared_ptr<TransactionDedupe> ApiClient::global_seen_transactions =
+        std::make_shared<TransactionDedupe>(ApiClient::dedupe_window);
+
+std::shared_ptr<AddressCache<std::string, ApiClient::Verdict>> ApiClient::sanctions_cache =
+        std::make_shared<AddressCache<std::string, ApiClient::Verdict>>(ApiClient::SANCTIONS_CACHE_CAPACITY);
+std::mutex ApiClient::sanctions_cache_mutex;
+
+bool ApiClient::full_payloads = false;
+
+bool ApiClient::prefetch_enabled = false;
+std::deque<std::pair<std::string, size_t>> ApiClient::prefetch_queue;
+AddressCache<std::string, bool> ApiClient::prefetch_seen(ApiClient::PREFETCH_SEEN_CAPACITY);
+std::mutex ApiClient::prefetch_mutex;
+
+ApiClient::ApiClient(const std::string& target) : ApiClient(target, URLs{}) {}
+
+ApiClient::ApiClient(const std::string& target, const URLs& urls) : urls(urls), target(target) {
     transaction_addresses = std::make_shared<std::vector<std::string>>();
-    cache = std::make_shared<AddressCache<std::string, httplib::Response>>(100);
+    seen_transactions = std::make_shared<TransactionDedupe>(dedupe_window);
+}
+
+void ApiClient::setWorkQueue(std::shared_ptr<WorkQueue> queue) {
+    work_queue = queue;
+}
+
+void ApiClient::setPriority(Priority priority) {
+    this->priority = priority;
+}
+
+void ApiClient::setTenant(size_t tenant) {
+    this->tenant = tenant;
+}
+
+Priority ApiClient::getPriority() const {
+    auto hit = last_sanctioned_hit.load();
+    if (0 == hit) return priority;
+    auto since_hit = std::chrono::steady_clock::now().time_since_epoch().count() - hit;
+    if (since_hit < std::chrono::steady_clock::duration(SANCTIONS_FOLLOW_UP).count()) return Priority::URGENT;
+    return priority;
+}
+
+void ApiClient::markSanctionedHit() {
+    last_sanctioned_hit.store(std::chrono::steady_clock::now().time_since_epoch().count());
+}
+
+void ApiClient::setDedupeWindow(size_t window) {
+    dedupe_window = window;
+    global_seen_transactions = std::make_shared<TransactionDedupe>(window);
+}
+
+void ApiClient::setFullPayloads(bool enabled) {
+    full_payloads = enabled;
+}
+
+void ApiClient::setTransport(std::shared_ptr<Transport> transport) {
+    ApiClient::transport = std::move(transport);
+}
+
+httplib::Result ApiClient::sendGet(const std::string& host, const std::string& path,
+                                   const std::string& operation, const httplib::Headers& headers) {
+    return coalesce("GET " + host + path, [&]() {
+        std::string key;
+        if (!admit(host, operation, key)) return httplib::Result(nullptr, httplib::Error::Canceled);
+        return hedge(host, operation, key, [&](const std::string& key, WireStats& wire, Cancellation* cancellation) {
+            return transport->get(host, KeyPool::withKey(path, key), withKey(headers, key), wire, cancellation);
+        });
+    });
+}
+
+httplib::Result ApiClient::sendPost(const std::string& host, const std::string& path, const std::string& operation,
+                                    const httplib::Headers& headers, const std::string& body) {
+    return coalesce("POST " + host + path + "\n" + body, [&]() {
+        std::string key;
+        if (!admit(host, operation, key)) return httplib::Result(nullptr, httplib::Error::Canceled);
+        return hedge(host, operation, key, [&](const std::string& key, WireStats& wire, Cancellation* cancellation) {
+            return transport->post(host, KeyPool::withKey(path, key), withKey(headers, key), body,
+                                   "application/json", wire, cancellation);
+        });
+    });
+}
+
+httplib::Result ApiClient::hedge(const std::string& host, const std::string& operation, const std::string& key,
+                                 const Attempt& attempt) {
+    const std::string provider = providerName(host);
+    auto answered = [&](const httplib::Result& res, std::chrono::steady_clock::time_point sent) {
+        if (res && ApiClient::OK == res->status) Hedging::record(provider, operation, std::chrono::steady_clock::now() - sent);
+    };
+    /* background work has no one waiting on it, a faster answer isn't worth the duplicate */
+    auto delay = Priority::BACKGROUND == getPriority() ? std::chrono::steady_clock::duration::zero()
+                                                      : Hedging::delay(provider, operation);
+    auto sent = std::chrono::steady_clock::now();
+    if (delay == std::chrono::steady_clock::duration::zero()) {
+        WireStats wire;
+        httplib::Result res = attempt(key, wire, nullptr);
+        answered(res, sent);
+        return countRequest(host, key, std::move(res), wire);
+    }
+
+    struct Race {
+        std::mutex mutex;
+        bool done = false;
+        bool hedge_won = false;
+        // the duplicate's response, kept should the original fail outright
+        httplib::Result hedged;
+        Cancellation original;
+        Cancellation duplicate;
+        // only started once a duplicate actually goes out
+        std::thread hedger;
+    } race;
+    auto sendDuplicate = [&](std::string hedge_key) {
+        WireStats wire;
+        auto hedge_sent = std::chrono::steady_clock::now();
+        httplib::Result res = attempt(hedge_key, wire, &race.duplicate);
+        answered(res, hedge_sent);
+        res = countRequest(host, hedge_key, std::move(res), wire);
+        if (race.duplicate.cancelled()) return;
+        /* an error is no answer, the original keeps going */
+        if (!res) return;
+        {
+            std::lock_guard<std::mutex> lock(race.mutex);
+            race.hedged = std::move(res);
+            if (race.done) return;
+            race.hedge_won = true;
+        }
+        Metrics::get(provider).hedgeWins++;
+        race.original.cancel();
+    };
+    /* the shared hedge thread only decides whether a duplicate goes out, most requests are answered first */
+    Hedging::Timer timer = Hedging::arm(sent + delay, [&]() {
+        if (!Hedging::spend(provider)) return;
+        std::string hedge_key;
+        /* a hedge only goes out on tokens to spare right now, it never queues for them */
+        if (0 != KeyPool::tryAcquire(provider, operation, getPriority(), hedge_key, key)) {
+            Hedging::refund(provider);
+            return;
+        }
+        Metrics::get(provider).hedges++;
+        race.hedger = std::thread(sendDuplicate, hedge_key);
+    });
+
+    WireStats wire;
+    httplib::Result res = attempt(key, wire, &race.original);
+    /* from here on the hedger is either started or never will be */
+    Hedging::disarm(timer);
+    bool hedge_won = false;
+    {
+        std::lock_guard<std::mutex> lock(race.mutex);
+        race.done = true;
+        hedge_won = race.hedge_won;
+    }
+    /* a failed original lets a duplicate already out finish, in case it still answers */
+    if (!hedge_won && res) race.duplicate.cancel();
+    if (race.hedger.joinable()) race.hedger.join();
+    /* a cancelled original was still paid for, so it is counted all the same */
+    answered(res, sent);
+    res = countRequest(host, key, std::move(res), wire);
+    if (hedge_won || (!res && race.hedged)) return std::move(race.hedged);
+    return res;
+}
+
+bool ApiClient::admit(const std::string& host, const std::string& operation, std::string& key) const {
+    const std::string provider = providerName(host);
+    if (KeyPool::acquire(provider, operation, getPriority(), key)) return true;
+    Metrics::get(provider).droppedRequests++;
+    return false;
+}
+
+httplib::Headers ApiClient::withKey(const httplib::Headers& headers, const std::string& key) {
+    httplib::Headers keyed;
+    for (const auto& [name, value] : headers) keyed.emplace(name, KeyPool::withKey(value, key));
+    return keyed;
+}
+
+bool ApiClient::isKeyThrottled(const std::string& provider, const httplib::Result& res) {
+    if (!res) return false;
+    if (ApiClient::TOO_MANY_REQUESTS == res->status) return true;
+    /* etherscan answers an exhausted key with a 200 and a string result */
+    return "etherscan" == provider && std::string::npos != res->body.find("Max rate limit reached");
+}
+
+httplib::Result ApiClient::countRequest(const std::string& host, const std::string& key, httplib::Result res,
+                                        const WireStats& wire) {
+    const std::string provider = providerName(host);
+    Metrics::Counters& metrics = Metrics::get(provider);
+    metrics.requests++;
+    /* an attempt given up for a faster answer to the same request did not fail */
+    if (!res && httplib::Error::Canceled == res.error()) metrics.cancelledRequests++;
+    else if (!res || ApiClient::OK != res->status) metrics.failedRequests++;
+    if (res) metrics.responseBytes += static_cast<long long>(res->body.size());
+    metrics.wireBytes += wire.bytes;
+    metrics.decodeMicros += wire.decoding.count();
+    if (isKeyThrottled(provider, res)) {
+        metrics.throttledRequests++;
+        std::chrono::seconds cooldown = KEY_COOLDOWN;
+        if (res->has_header("Retry-After")) {
+            try {
+                cooldown = std::chrono::seconds(std::max(1, std::stoi(res->get_header_value("Retry-After"))));
+            } catch (...) {}
+        }
+        KeyPool::coolDown(provider, key, cooldown);
+    }
+    return res;
+}
+
+std::string ApiClient::providerName(const std::string& host) const {
+    if (host == urls.etherscan_url) return "etherscan";
+    if (host == urls.tron_url) return "trongrid";
+    if (host == urls.shyft_url) return "shyft";
+    if (host == urls.chainalysis_url) return "chainalysis";
+    return host;
+}
+
+httplib::Result ApiClient::coalesce(const std::string& key, const std::function<httplib::Result()>& send) const {
+    /* background calls give up when tokens run short, which must not fail a real-time call that joined them */
+    const std::string flight = Priority::BACKGROUND == getPriority() ? "background " + key : key;
+    auto shared = in_flight.run(flight, [&]() {
+        return std::make_shared<const httplib::Result>(send());
+    });
+    /* every waiter gets its own copy, callers are free to move the body out */
+    if (!*shared) return httplib::Result(nullptr, shared->error());
+    return httplib::Result(std::make_unique<httplib::Response>(shared->value()), shared->error());
 }
 
 httplib::Result ApiClient::getCachedAddressResult(std::string address) {
     try {
-        httplib::Response& cached_response = this->cache->get(address);
-        auto res_ptr = std::make_unique<httplib::Response>(std::move(cached_response));
+        std::lock_guard<std::mutex> lock(sanctions_cache_mutex);
+        Verdict cached_verdict = sanctions_cache->get(address);
+        auto res_ptr = std::make_unique<httplib::Response>();
+        res_ptr->status = ApiClient::OK;
+        res_ptr->body = std::move(cached_verdict.body);
         return httplib::Result(std::move(res_ptr), httplib::Error::Success);
     } catch (...) {
         return httplib::Result(nullptr, httplib::Error::Success);
     }
 }
 
+std::vector<ApiClient::Transaction> ApiClient::parseTransactions(const std::string& body) {
+    std::vector<Transaction> transactions;
+    size_t pos = body.find("\"result\":[");
+    if (pos == std::string::npos) return transactions;
+    /* txlist entries are flat objects, so each one runs from its '{' to the next '}' */
+    while ((pos = body.find("{", pos)) != std::string::npos) {
+        size_t end = body.find("}", pos);
+        if (end == std::string::npos) break;
+        std::string obj = body.substr(pos, end - pos);
+        pos = end + 1;
+        Transaction tx;
+        try {
+            tx.blockNumber = std::stoll(extractValue(obj, "blockNumber"));
+        } catch (...) {
+            continue;
+        }
+        tx.hash = extractValue(obj, "hash");
+        tx.from = extractValue(obj, "from");
+        tx.to = extractValue(obj, "to");
+        transactions.push_back(tx);
+    }
+    return transactions;
+}
+
+std::string ApiClient::extractValue(const std::string& body, const std::string& key) {
+    size_t pos = body.find("\"" + key + "\":");
+    if (pos == std::string::npos) return "";
+    size_t start = body.find_first_not_of(" \t\r\n", pos + key.length() + 3);
+    if (start == std::string::npos) return "";
+    if (body[start] == '"') {
+        start++;
+        size_t end = body.find("\"", start);
+        if (end == std::string::npos) return "";
+        return body.substr(start, end - start);
+    }
+    size_t end = body.find_first_of(",}] \t\r\n", start);
+    return body.substr(start, end == std::string::npos ? std::string::npos : end - start);
+}
+
+uint64_t ApiClient::fingerprint(const std::string& body) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : body) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool ApiClient::isUnchangedBody(const std::string& endpoint, const std::string& body) {
+    uint64_t hash = fingerprint(body);
+    auto it = body_fingerprints.find(endpoint);
+    if (it != body_fingerprints.end() && it->second == hash) return true;
+    body_fingerprints[endpoint] = hash;
+    return false;
+}
+
+bool ApiClient::isTransactionList(const std::string& body) {
+    return std::string::npos != body.find("\"result\":[");
+}
+
+std::string ApiClient::transactionPagePath(int page, size_t offset, long long startBlock,
+                                           long long endBlock, const std::string& sort) const {
+    return "/api?module=account"
+           "&action=txlist"
+           "&address=" + this->target +
+           "&startblock=" + std::to_string(startBlock) +
+           "&endblock=" + std::to_string(endBlock) +
+           "&page=" + std::to_string(page) +
+           "&offset=" + std::to_string(offset) +
+           "&sort=" + sort +
+           "&apikey=" + KeyPool::PLACEHOLDER;
+}
+
+httplib::Result ApiClient::fetchTransactionPage(int page, size_t offset, long long startBlock,
+                                                long long endBlock, const std::string& sort) {
+    return sendGet(urls.etherscan_url, transactionPagePath(page, offset, startBlock, endBlock, sort), "txlist");
+}
+
+void ApiClient::stageCounterparties(const std::vector<Transaction>& transactions) {
+    std::string self = this->target;
+    std::transform(self.begin(), self.end(), self.begin(), ::tolower);
+    transaction_addresses->clear();
+    std::set<std::string> unique_addresses;
+    for (const Transaction& tx : transactions) {
+        for (const std::string& addr : {tx.to, tx.from}) {
+            if (42 == addr.length() && addr.substr(0, 2) == "0x" && addr != self) {
+                unique_addresses.insert(addr);
+            }
+        }
+    }
+    for (const std::string& addr : unique_addresses) {
+        transaction_addresses->push_back(addr);
+    }
+}
+
+std::vector<ApiClient::Transaction> ApiClient::filterSeen(const std::vector<Transaction>& transactions) {
+    std::vector<Transaction> fresh;
+    for (const Transaction& tx : transactions) {
+        TransactionDedupe::Hash hash;
+        if (!TransactionDedupe::parseHash(tx.hash, hash)) {
+            fresh.push_back(tx);
+            continue;
+        }
+        if (!seen_transactions->insert(hash)) continue;
+        /* a transfer between two watched targets shows up in both lists, only the first one reports it */
+        if (!global_seen_transactions->insert(hash)) continue;
+        fresh.push_back(tx);
+    }
+    return fresh;
+}
+
+std::string ApiClient::fetchHistoryBounds(long long& firstBlock, long long& latestBlock) {
+    auto first = fetchTransactionPage(1, 1, 0, 99999999, "asc");
+    if (!first || ApiClient::OK != first->status || !isTransactionList(first->body)) {
+        OutputSink::line("ETH history bounds: first transaction lookup failed");
+        return first ? std::to_string(first->status) : "Error: " + errorToString(first.error());
+    }
+    std::vector<Transaction> oldest = parseTransactions(first->body);
+    if (oldest.empty()) {
+        OutputSink::line("ETH history bounds: target has no transactions");
+        return std::to_string(ApiClient::NOT_FOUND);
+    }
+    firstBlock = oldest.front().blockNumber;
+
+    const std::string path = "/api?module=proxy"
+                             "&action=eth_blockNumber"
+                             "&apikey=" + std::string(KeyPool::PLACEHOLDER);
+    auto head = sendGet(urls.etherscan_url, path, "eth_blockNumber");
+    if (!head || ApiClient::OK != head->status) {
+        OutputSink::line("ETH history bounds: block number lookup failed");
+        return head ? std::to_string(head->status) : "Error: " + errorToString(head.error());
+    }
+    size_t pos = head->body.find("\"result\":\"0x");
+    if (pos == std::string::npos) {
+        OutputSink::line("ETH history bounds: unexpected block number response");
+        return "Error: " + head->body.substr(0, 200);
+    }
+    /* "0x" alone or garbage after it would throw out of the backfill thread */
+    try {
+        latestBlock = std::stoll(head->body.substr(pos + 12), nullptr, 16);
+    } catch (const std::exception&) {
+        OutputSink::line("ETH history bounds: unexpected block number response");
+        return "Error: " + head->body.substr(0, 200);
+    }
+    return std::to_string(ApiClient::OK);
+}
+
+std::string ApiClient::fetchTransactionRange(long long startBlock, long long endBlock) {
+    std::vector<Transaction> transactions;
+    const int last_page = ETH_MAX_RESULT_WINDOW / ETH_BACKFILL_PAGE_SIZE;
+    for (int page = 1; page <= last_page; ++page) {
+        auto res = fetchTransactionPage(page, ETH_BACKFILL_PAGE_SIZE, startBlock, endBlock, "asc");
+        if (!res) return "Error: " + errorToString(res.error());
+        if (ApiClient::OK != res->status) return std::to_string(res->status);
+        if (!isTransactionList(res->body)) return "Error: " + res->body.substr(0, 200);
+        std::vector<Transaction> batch = parseTransactions(res->body);
+        transactions.insert(transactions.end(), batch.begin(), batch.end());
+        if (ETH_BACKFILL_PAGE_SIZE > batch.size()) {
+            stageCounterparties(transactions);
+            return std::to_string(ApiClient::OK);
+        }
+    }
+    return std::to_string(ApiClient::TOO_LARGE);
+}
+
+std::vector<ApiClient::Transaction> ApiClient::fetchCatchUpPages(bool& failed) {
+    std::vector<Transaction> transactions;
+    const int last_page = ETH_MAX_RESULT_WINDOW / ETH_PAGE_SIZE;
+    bool reached_cursor = false;
+    int next_page = 2;
+    /* the rate limiter paces the calls, waves only bound how far past the cursor we may read */
+    while (!reached_cursor && !failed && next_page <= last_page) {
+        /* each page is fetched and parsed in its own unit of work */
+        std::vector<std::future<CatchUpPage>> wave;
+        for (size_t i = 0; i < ETH_CATCH_UP_WAVE_SIZE && next_page <= last_page; ++i, ++next_page) {
+            auto fetch = [this, next_page]() {
+                return readCatchUpPage(fetchTransactionPage(next_page, ETH_PAGE_SIZE, pollStartBlock()));
+            };
+            wave.push_back(work_queue ? work_queue->submit(fetch, getPriority(), tenant) : std::async(std::launch::async, fetch));
+        }
+        /* pages are consumed in order, so the first one that reaches the cursor ends the catch-up */
+        for (auto& pending : wave) {
+            auto page = work_queue ? work_queue->waitFor(pending) : pending.get();
+            if (reached_cursor || failed) continue;
+            reached_cursor = takeCatchUpPage(page, transactions, failed);
+        }
+    }
+    if (!reached_cursor && !failed) {
+        OutputSink::line("ETH catch-up hit the ", ETH_MAX_RESULT_WINDOW, " result window before reaching the cursor");
+    }
+    return transactions;
+}
+
+ApiClient::CatchUpPage ApiClient::readCatchUpPage(const httplib::Result& res) {
+    if (!res) return {errorToString(res.error()), {}};
+    if (ApiClient::OK != res->status || !isTransactionList(res->body)) return {std::to_string(res->status), {}};
+    return {"", parseTransactions(res->body)};
+}
+
+bool ApiClient::takeCatchUpPage(const CatchUpPage& page, std::vector<Transaction>& transactions, bool& failed) {
+    if (!page.first.empty()) {
+        OutputSink::line("ETH catch-up page failed for ", this->target, ": ", page.first);
+        failed = true;
+        return false;
+    }
+    for (const Transaction& tx : page.second) {
+        if (!isNewerThanCursor(tx)) return true;
+        transactions.push_back(tx);
+    }
+    return ETH_PAGE_SIZE > page.second.size();
+}
+
+std::string ApiClient::readFirstPage(const httplib::Result& res, std::vector<Transaction>& transactions) {
+    if (!res) return "Error: " + errorToString(res.error());
+    if (ApiClient::OK != res->status) {
+        OutputSink::line("ETH API error: ", res->status);
+        return std::to_string(res->status);
+    }
+    OutputSink::line("ETH API call successful. Received ", res->body.length(), " bytes");
+    /* the list is newest first, so an identical first page means nothing new anywhere */
+    if (isUnchangedBody("txlist", res->body)) {
+        OutputSink::line("ETH response unchanged since last poll");
+        return std::to_string(ApiClient::NOT_MODIFIED);
+    }
+    transactions = parseTransactions(res->body);
+    return "";
+}
+
+long long ApiClient::pollStartBlock() const {
+    /* the cursor block is asked for again, it is how a page shows it reached the cursor */
+    return full_payloads || cursor_block < 0 ? 0 : cursor_block;
+}
+
+bool ApiClient::needsCatchUp(const std::vector<Transaction>& transactions) const {
+    return cursor_block >= 0 && ETH_PAGE_SIZE == transactions.size() && isNewerThanCursor(transactions.back());
+}
+
+std::string ApiClient::ingestTransactions(const std::vector<Transaction>& transactions, bool failed) {
+    /* a failed catch-up keeps the cursor so the next poll pages back over the gap again */
+    if (!failed) advanceCursor(transactions);
+    else body_fingerprints.erase("txlist");
+
+    std::vector<Transaction> fresh = filterSeen(transactions);
+    if (fresh.empty()) {
+        transaction_addresses->clear();
+        OutputSink::line("No new transactions since last poll");
+        return std::to_string(ApiClient::OK);
+    }
+    stageCounterparties(fresh);
+    if (prefetch_enabled) queueFirstHops(fresh);
+    Metrics::get("ethereum").newTransactions += static_cast<long long>(fresh.size());
+    std::ostringstream extracted;
+    extracted << "Extracted " << transaction_addresses->size() << " addresses from "
+              << fresh.size() << " new transactions of " << this->target;
+    for (size_t i = 0; i < transaction_addresses->size(); i++) {
+        extracted << "\n  Address " << (i+1) << ": " << (*transaction_addresses)[i];
+    }
+    OutputSink::line(extracted.str());
+    return std::to_string(ApiClient::OK);
+}
+
+bool ApiClient::isNewerThanCursor(const Transaction& tx) const {
+    if (tx.blockNumber != cursor_block) return tx.blockNumber > cursor_block;
+    return cursor_hashes.find(tx.hash) == cursor_hashes.end();
+}
+
+void ApiClient::advanceCursor(const std::vector<Transaction>& transactions) {
+    for (const Transaction& tx : transactions) {
+        if (tx.blockNumber > cursor_block) {
+            cursor_block = tx.blockNumber;
+            cursor_hashes.clear();
+        }
+        if (tx.blockNumber == cursor_block) cursor_hashes.insert(tx.hash);
+    }
+}
+
 template<ApiClient::USE u>
-std::string ApiClient::sendGETRequest() {
-    auto eth_handler = [this]() -> std::string {
-        auto eth_client = std::make_unique<httplib::Client>(URLs{}.etherscan_url);
+bool ApiClient::hasNewActivity() {
+    std::string state;
+    bool probed = false;
+    if constexpr (u == ApiClient::USE::FETCH_TRANSACTIONS_ETH) {
+        /* balance moves on incoming funds and, through gas, on every outgoing transaction */
         const std::string path = "/api?module=account"
-                                 "&action=txlist"
+                                 "&action=balance"
                                  "&address=" + this->target +
-                                 "&startblock=0"
-                                 "&endblock=99999999"
-                                 "&page=1"
-                                 "&offset=10"
-                                 "&sort=desc"
-                                 "&apikey=" + std::getenv("ETHERSCAN_API_KEY");
-        auto res = eth_client->Get(path.c_str());
-        if (res) {
-            if (ApiClient::OK == res->status) {
-                std::cout << "ETH API call successful. Received " << res->body.length() << " bytes" << std::endl;
-                std::string response = res->body;
-                transaction_addresses->clear();
-                std::set<std::string> unique_addresses;
-                size_t pos = 0;
-                while ((pos = response.find("\"to\":", pos)) != std::string::npos) {
-                    pos += 5;
-                    size_t start = response.find("\"", pos);
-                    if (start != std::string::npos) {
-                        start++;
-                        size_t end = response.find("\"", start);
-                        if (end != std::string::npos) {
-                            std::string addr = response.substr(start, end - start);
-                            if (42 == addr.length() && addr.substr(0, 2) == "0x") {
-                                unique_addresses.insert(addr);
-                            }
-                        }
-                    }
-                }
-                pos = 0;
-                while ((pos = response.find("\"from\":", pos)) != std::string::npos) {
-                    pos += 7;
-                    size_t start = response.find("\"", pos);
-                    if (start != std::string::npos) {
-                        start++;
-                        size_t end = response.find("\"", start);
-                        if (end != std::string::npos) {
-                            std::string addr = response.substr(start, end - start);
-                            if (42 == addr.length() && addr.substr(0, 2) == "0x" && addr != this->target) {
-                                unique_addresses.insert(addr);
-                            }
-                        }
-                    }
-                }
-                for (const std::string& addr : unique_addresses) {
-                    transaction_addresses->push_back(addr);
-                }
-                std::cout << "Extracted " << transaction_addresses->size() << " addresses from transactions" << "\n";
-                for (size_t i = 0; i < transaction_addresses->size(); i++) {
-                    std::cout << "  Address " << (i+1) << ": " << (*transaction_addresses)[i] << "\n";
-                }
-                return std::to_string(ApiClient::OK);
-            } else {
-                std::cout << "ETH API error: " << res->status << "\n";
-                return std::to_string(res->status);
-            }
+                                 "&tag=latest"
+                                 "&apikey=" + KeyPool::PLACEHOLDER;
+        auto res = sendGet(urls.etherscan_url, path, "balance");
+        if (res && ApiClient::OK == res->status && std::string::npos != res->body.find("\"status\":\"1\"")) {
+            if (isUnchangedBody("balance", res->body) && has_probe_state) return false;
+            state = extractValue(res->body, "result");
+            probed = true;
         }
-        return "Error: " + errorToString(res.error());
-    };
-    auto sanctions_handler = [this]() -> std::string {
-        auto sanctions_client = std::make_unique<httplib::Client>(URLs{}.chainalysis_url);
+    } else if constexpr (u == ApiClient::USE::FETCH_TRANSACTIONS_TRON) {
         httplib::Headers headers = {
-                {"X-API-KEY", std::getenv("CHAINALYSIS_API_KEY")},
+                {"Content-Type", "application/json"},
+                {"TRON-PRO-API-KEY", KeyPool::PLACEHOLDER},
+        };
+        std::string body = R"({ "address": ")" + this->target + R"(", "visible": true })";
+        auto res = sendPost(urls.tron_url, urls.tron_endpoint, "getaccount", headers, body);
+        if (res && ApiClient::OK == res->status) {
+            if (isUnchangedBody("getaccount", res->body) && has_probe_state) return false;
+            state = extractValue(res->body, "balance") + "/" + extractValue(res->body, "latest_opration_time");
+            probed = true;
+        }
+    } else if constexpr (u == ApiClient::USE::FETCH_TRANSACTIONS_SOL) {
+        httplib::Headers headers = {
+                {"Content-Type", "application/json"}
         };
-        std::map<std::string, bool> isAddressSanctioned;
-        auto isSanctionedAddress = [this, &sanctions_client]
-                (std::string addr, httplib::Headers headers, std::map<std::string, bool>& isAddressSanctioned) -> std::string {
-            auto res = sanctions_client->Get(URLs{}.chainalysis_endpoint+addr, headers);
-            if (res) {
-                if (ApiClient::OK == res->status) {
-                    this->cache->put(addr, *res);
-                    isAddressSanctioned[addr] = std::string::npos != res->body.find("sanctions");
-                    return std::to_string(ApiClient::OK);
-                } else {
-                    isAddressSanctioned[addr] = false;
-                    return std::to_string(res->status);
+        std::string body = R"({
+            "jsonrpc": "2.0",
+            "id": 1,
+            "method": "getSignaturesForAddress",
+            "params": [
+                ")" + this->target + R"(",
+                {
+                    "commitment": "finalized",
+                    "limit": 1
                 }
-            } else {
-                isAddressSanctioned[addr] = false;
-                return "Error: " + errorToString(res.error());
-            }
+            ]
+        })";
+        auto res = sendPost(urls.shyft_url, urls.shyft_endpoint + KeyPool::PLACEHOLDER,
+                            "getSignaturesForAddress", headers, body);
+        if (res && ApiClient::OK == res->status && std::string::npos != res->body.find("\"result\":[")) {
+            if (isUnchangedBody("getSignaturesForAddress", res->body) && has_probe_state) return false;
+            state = extractValue(res->body, "signature");
+            probed = true;
+        }
+    } else {
+        throw std::runtime_error("Error: Invalid use case for activity probe.");
+    }
+
+    /* a failed probe falls through to the full fetch rather than risk missing activity */
+    if (!probed) return true;
+    bool changed = !has_probe_state || state != probe_state;
+    probe_state = state;
+    has_probe_state = true;
+    return changed;
+}
+
+void ApiClient::resetActivityProbe() {
+    has_probe_state = false;
+    body_fingerprints.clear();
+}
+
+template<ApiClient::USE u>
+std::string ApiClient::sendGETRequest() {
+    auto eth_handler = [this]() -> std::string {
+        std::vector<Transaction> transactions;
+        std::string status = readFirstPage(fetchTransactionPage(1, ETH_PAGE_SIZE, pollStartBlock()), transactions);
+        if (!status.empty()) return status;
+        bool failed = false;
+        if (needsCatchUp(transactions)) {
+            std::vector<Transaction> older = fetchCatchUpPages(failed);
+            OutputSink::line("ETH catch-up fetched ", older.size(), " more transactions");
+            transactions.insert(transactions.end(), older.begin(), older.end());
+        }
+        return ingestTransactions(transactions, failed);
+    };
+    auto sanctions_handler = [this]() -> std::string {
+        size_t failed = 0;
+        auto report = [&failed](const std::string& addr, const std::pair<std::string, bool>& verdict) {
+            OutputSink::line(std::boolalpha, verdict.first, " ", addr, " Sanctioned status: ", verdict.second);
+            if (!isScreened(verdict.first)) failed++;
         };
-        for (const std::string& addr : *transaction_addresses) {
-            std::string result = isSanctionedAddress(addr, headers, isAddressSanctioned);
-            std::cout << std::boolalpha;
-            std::cout << result << " Sanctioned status: " << static_cast<bool>(isAddressSanctioned[addr]) << "\n";
+        const std::vector<std::string>& addresses = *transaction_addresses;
+        if (!work_queue) {
+            for (const std::string& addr : addresses) report(addr, screenAddress(addr));
+            return screeningResult(failed, addresses.size());
+        }
+        /* each address is its own unit of work, so idle workers can steal the tail of a long list */
+        std::vector<std::future<std::pair<std::string, bool>>> screens;
+        for (const std::string& addr : addresses) {
+            screens.push_back(work_queue->submit([this, &addr]() { return screenAddress(addr); }, getPriority(), tenant));
+        }
+        /* results are reported in address order once each one is in */
+        for (size_t i = 0; i < screens.size(); ++i) {
+            report(addresses[i], work_queue->waitFor(screens[i]));
         }
-        return "Sanctions check complete";
+        return screeningResult(failed, addresses.size());
     };
 
     if constexpr (u == ApiClient::USE::FETCH_TRANSACTIONS_ETH) return eth_handler();
@@ -125,13 +646,12 @@ template<ApiClient::USE u>
 std::string ApiClient::sendPOSTRequest() {
     std::map<ApiClient::USE, std::function<std::string()>> post_map;
     post_map[ApiClient::USE::FETCH_TRANSACTIONS_TRON] = [this]() -> std::string {
-        auto tron_client = std::make_unique<httplib::Client>(URLs{}.tron_url);
         httplib::Headers headers = {
                 {"Content-Type", "application/json"},
-                {"TRON-PRO-API-KEY", std::getenv("TRON_API_KEY")},
+                {"TRON-PRO-API-KEY", KeyPool::PLACEHOLDER},
         };
         std::string body = R"({ "address": ")" + this->target + R"(", "visible": true })";
-        auto res = tron_client->Post(URLs{}.tron_endpoint, headers, body, "application/json");
+        auto res = sendPost(urls.tron_url, urls.tron_endpoint, "getaccount", headers, body);
         if (res) {
             if (ApiClient::OK == res->status) return std::to_string(ApiClient::OK);
             else return std::to_string(res->status);
@@ -139,10 +659,12 @@ std::string ApiClient::sendPOSTRequest() {
         return "Error: " + errorToString(res.error());
     };
     post_map[ApiClient::USE::FETCH_TRANSACTIONS_SOL] = [this]() -> std::string {
-        auto sol_client = std::make_unique<httplib::Client>(URLs{}.shyft_url);
         httplib::Headers headers = {
                 {"Content-Type", "application/json"}
         };
+        /* the account data is never read, only whether the account changed, so none of it is asked for */
+        const std::string data = full_payloads ? R"("encoding": "base58")"
+                                               : R"("encoding": "base64", "dataSlice": { "offset": 0, "length": 0 })";
         std::string body = R"({
             "jsonrpc": "2.0",
             "id": 1,
@@ -151,12 +673,14 @@ std::string ApiClient::sendPOSTRequest() {
                 ")" + this->target + R"(",
                 {
                     "commitment": "finalized",
-                    "encoding": "base58"
+                    )" + data + R"(
                 }
             ]
         })";
-        auto res = sol_client->Post(URLs{}.shyft_endpoint + std::getenv("SHYFT_API_KEY"), headers, body, "application/json");
+        auto res = sendPost(urls.shyft_url, urls.shyft_endpoint + KeyPool::PLACEHOLDER,
+                            "getAccountInfo", headers, body);
         if (res) {
+            if (ApiClient::OK == res->status && isUnchangedBody("getAccountInfo", res->body)) return std::to_string(ApiClient::NOT_MODIFIED);
             if (ApiClient::OK == res->status) return std::to_string(ApiClient::OK);
             else return std::to_string(res->status);
         }
@@ -170,6 +694,243 @@ std::string ApiClient::sendPOSTRequest() {
     }
 }
 
+std::string ApiClient::fetchVerdict(const std::string& address, const httplib::Headers& headers, bool& sanctioned) {
+    return storeVerdict(address, sendGet(urls.chainalysis_url, urls.chainalysis_endpoint + address, "address", headers),
+                        sanctioned);
+}
+
+std::string ApiClient::storeVerdict(const std::string& address, const httplib::Result& res, bool& sanctioned) {
+    if (!res) return "Error: " + errorToString(res.error());
+    if (ApiClient::OK != res->status) return std::to_string(res->status);
+    sanctioned = std::string::npos != res->body.find("sanctions");
+    std::lock_guard<std::mutex> lock(sanctions_cache_mutex);
+    sanctions_cache->put(address, {sanctioned, res->body, std::chrono::steady_clock::now()});
+    return std::to_string(ApiClient::OK);
+}
+
+bool ApiClient::cachedVerdict(const std::string& address, bool& sanctioned) {
+    std::lock_guard<std::mutex> lock(sanctions_cache_mutex);
+    if (!sanctions_cache->contains(address)) return false;
+    Verdict verdict = sanctions_cache->get(address);
+    if (std::chrono::steady_clock::now() - verdict.fetched >= SANCTIONS_TTL) return false;
+    sanctioned = verdict.sanctioned;
+    return true;
+}
+
+std::pair<std::string, bool> ApiClient::screenAddress(const std::string& address) {
+    Metrics::Counters& metrics = Metrics::get("sanctions");
+    metrics.screened++;
+    bool sanctioned = false;
+    std::string result;
+    if (cachedVerdict(address, sanctioned)) {
+        metrics.cacheHits++;
+        result = std::to_string(ApiClient::OK) + " (cached)";
+    } else {
+        httplib::Headers headers = {
+                {"X-API-KEY", KeyPool::PLACEHOLDER},
+        };
+        result = fetchVerdict(address, headers, sanctioned);
+    }
+    if (sanctioned) {
+        metrics.sanctionedHits++;
+        markSanctionedHit();
+    }
+    return {result, sanctioned};
+}
+
+bool ApiClient::isRefused(const std::string& result) {
+    return result == "Error: " + errorToString(httplib::Error::Canceled);
+}
+
+bool ApiClient::isScreened(const std::string& result) {
+    /* a fresh verdict reads "200", one from the cache "200 (cached)" */
+    return 0 == result.rfind(std::to_string(ApiClient::OK), 0);
+}
+
+std::string ApiClient::screeningResult(size_t failed, size_t screened) {
+    if (0 == failed) return "Sanctions check complete";
+    return "Error: " + std::to_string(failed) + " of " + std::to_string(screened) + " sanctions screens failed";
+}
+
+std::vector<std::string> ApiClient::expiringVerdicts(size_t limit) {
+    std::vector<std::string> expiring;
+    auto stale_after = std::chrono::steady_clock::now() - (SANCTIONS_TTL - SANCTIONS_REFRESH_AHEAD);
+    std::lock_guard<std::mutex> lock(sanctions_cache_mutex);
+    sanctions_cache->forEach([&](const std::string& address, const Verdict& verdict) {
+        if (verdict.fetched < stale_after) expiring.push_back(address);
+        return expiring.size() < limit;
+    });
+    return expiring;
+}
+
+std::string ApiClient::refreshVerdict(const std::string& address) {
+    httplib::Headers headers = {
+            {"X-API-KEY", KeyPool::PLACEHOLDER},
+    };
+    bool sanctioned = false;
+    return fetchVerdict(address, headers, sanctioned);
+}
+
+void ApiClient::setPrefetch(bool enabled) {
+    prefetch_enabled = enabled;
+}
+
+bool ApiClient::nextPrefetch(std::string& address, size_t& refusals) {
+    std::lock_guard<std::mutex> lock(prefetch_mutex);
+    if (prefetch_queue.empty()) return false;
+    address = std::move(prefetch_queue.front().first);
+    refusals = prefetch_queue.front().second;
+    prefetch_queue.pop_front();
+    return true;
+}
+
+bool ApiClient::deferPrefetch(const std::string& address, size_t refusals) {
+    if (refusals >= PREFETCH_MAX_REFUSALS) return false;
+    std::lock_guard<std::mutex> lock(prefetch_mutex);
+    prefetch_queue.emplace_front(address, refusals);
+    return true;
+}
+
+void ApiClient::queueFirstHops(const std::vector<Transaction>& transactions) {
+    std::string self = this->target;
+    std::transform(self.begin(), self.end(), self.begin(), ::tolower);
+    std::lock_guard<std::mutex> lock(prefetch_mutex);
+    for (const Transaction& tx : transactions) {
+        if (tx.from != self || 42 != tx.to.length() || tx.to == self) continue;
+        /* an address already prefetched recently, or a backlog this deep, isn't worth spare capacity */
+        if (prefetch_seen.contains(tx.to) || prefetch_queue.size() >= PREFETCH_QUEUE_CAPACITY) continue;
+        prefetch_seen.put(tx.to, true);
+        prefetch_queue.emplace_back(tx.to, 0);
+    }
+}
+
+std::string ApiClient::prefetchSecondHops() {
+    auto res = fetchTransactionPage(1, PREFETCH_PAGE_SIZE);
+    if (!res) return "Error: " + errorToString(res.error());
+    if (ApiClient::OK != res->status) return std::to_string(res->status);
+    if (!isTransactionList(res->body)) {
+        /* an address without transactions answers with an empty string result, there is nothing to warm */
+        return std::string::npos != res->body.find("No transactions found") ? std::to_string(ApiClient::OK)
+                                                                              : "Error: " + res->body.substr(0, 200);
+    }
+    stageCounterparties(parseTransactions(res->body));
+    httplib::Headers headers = {
+            {"X-API-KEY", KeyPool::PLACEHOLDER},
+    };
+    Metrics::Counters& metrics = Metrics::get("prefetch");
+    auto fresh_after = std::chrono::steady_clock::now() - (SANCTIONS_TTL - SANCTIONS_REFRESH_AHEAD);
+    for (const std::string& address : *transaction_addresses) {
+        metrics.screened++;
+        {
+            std::lock_guard<std::mutex> lock(sanctions_cache_mutex);
+            if (sanctions_cache->contains(address) && sanctions_cache->get(address).fetched >= fresh_after) {
+                metrics.cacheHits++;
+                continue;
+            }
+        }
+        bool sanctioned = false;
+        std::string result = fetchVerdict(address, headers, sanctioned);
+        if (result != std::to_string(ApiClient::OK)) return result;
+        if (sanctioned) metrics.sanctionedHits++;
+    }
+    return std::to_string(ApiClient::OK);
+}
+
+#ifdef NETZ_COROUTINES
+Async<httplib::Result> ApiClient::sendGet(EventLoop& loop, std::string host, std::string path, std::string operation,
+                                         httplib::Headers headers) {
+    /* the same key pool and limits as the blocking path, but waiting for tokens suspends instead of sleeping */
+    const std::string provider = providerName(host);
+    std::string key;
+    double waited = 0;
+    while (true) {
+        double wait = KeyPool::tryAcquire(provider, operation, getPriority(), key);
+        if (0 == wait) break;
+        if (!KeyPool::shouldWait(getPriority(), waited, wait)) {
+            Metrics::get(provider).droppedRequests++;
+            co_return httplib::Result(nullptr, httplib::Error::Canceled);
+        }
+        co_await Sleep{loop, wait};
+        waited += wait;
+    }
+    httplib::Headers keyed = withKey(headers, key);
+    keyed.emplace("Accept-Encoding", Decompressor::acceptEncoding());
+    EventLoop::Request request{"GET", host, KeyPool::withKey(path, key), std::move(keyed), ""};
+    Fetch fetch{loop, std::move(request)};
+    httplib::Result res = co_await fetch;
+    co_return countRequest(host, key, std::move(res), fetch.wire);
+}
+
+Async<std::string> ApiClient::fetchTransactions(EventLoop& loop) {
+    std::vector<Transaction> transactions;
+    httplib::Result first = co_await sendGet(loop, urls.etherscan_url,
+                                             transactionPagePath(1, ETH_PAGE_SIZE, pollStartBlock()), "txlist");
+    std::string status = readFirstPage(first, transactions);
+    if (!status.empty()) co_return status;
+    bool failed = false;
+    if (needsCatchUp(transactions)) {
+        std::vector<Transaction> older;
+        const int last_page = ETH_MAX_RESULT_WINDOW / ETH_PAGE_SIZE;
+        bool reached_cursor = false;
+        int next_page = 2;
+        while (!reached_cursor && !failed && next_page <= last_page) {
+            std::vector<Async<httplib::Result>> wave;
+            for (size_t i = 0; i < ETH_CATCH_UP_WAVE_SIZE && next_page <= last_page; ++i, ++next_page) {
+                wave.push_back(sendGet(loop, urls.etherscan_url,
+                                       transactionPagePath(next_page, ETH_PAGE_SIZE, pollStartBlock()), "txlist"));
+            }
+            std::vector<httplib::Result> pages = co_await WhenAll<httplib::Result>{std::move(wave)};
+            for (const httplib::Result& page : pages) {
+                if (reached_cursor || failed) continue;
+                reached_cursor = takeCatchUpPage(readCatchUpPage(page), older, failed);
+            }
+        }
+        if (!reached_cursor && !failed) {
+            OutputSink::line("ETH catch-up hit the ", ETH_MAX_RESULT_WINDOW, " result window before reaching the cursor");
+        }
+        OutputSink::line("ETH catch-up fetched ", older.size(), " more transactions");
+        transactions.insert(transactions.end(), older.begin(), older.end());
+    }
+    co_return ingestTransactions(transactions, failed);
+}
+
+Async<std::pair<std::string, bool>> ApiClient::screenAddress(EventLoop& loop, std::string address) {
+    Metrics::Counters& metrics = Metrics::get("sanctions");
+    metrics.screened++;
+    bool sanctioned = false;
+    std::string result;
+    if (cachedVerdict(address, sanctioned)) {
+        metrics.cacheHits++;
+        result = std::to_string(ApiClient::OK) + " (cached)";
+    } else {
+        httplib::Headers headers = {
+                {"X-API-KEY", KeyPool::PLACEHOLDER},
+        };
+        httplib::Result res = co_await sendGet(loop, urls.chainalysis_url, urls.chainalysis_endpoint + address,
+                                               "address", headers);
+        result = storeVerdict(address, res, sanctioned);
+    }
+    if (sanctioned) {
+        metrics.sanctionedHits++;
+        markSanctionedHit();
+    }
+    co_return std::make_pair(result, sanctioned);
+}
+
+Async<std::string> ApiClient::screenCounterparties(EventLoop& loop) {
+    const std::vector<std::string> addresses = *transaction_addresses;
+    std::vector<Async<std::pair<std::string, bool>>> screens;
+    for (const std::string& addr : addresses) screens.push_back(screenAddress(loop, addr));
+    std::vector<std::pair<std::string, bool>> verdicts = co_await WhenAll<std::pair<std::string, bool>>{std::move(screens)};
+    size_t failed = 0;
+    for (size_t i = 0; i < addresses.size(); ++i) {
+        OutputSink::line(std::boolalpha, verdicts[i].first, " ", addresses[i], " Sanctioned status: ", verdicts[i].second);
+        if (!isScreened(verdicts[i].first)) failed++;
+    }
+    co_return screeningResult(failed, addresses.size());
+}
+#endif
+
 std::string ApiClient::errorToString(httplib::Error err) {
     switch(err) {
         case httplib::Error::Success:
@@ -192,11 +953,16 @@ std::string ApiClient::errorToString(httplib::Error err) {
             return "SSL loading certificates error";
         case httplib::Error::SSLServerVerification:
             return "SSL server verification error";
+        case httplib::Error::Compression:
+            return "Could not decode compressed response";
         default:
             return "Unknown error";
     }
 }
 
+template bool ApiClient::hasNewActivity<ApiClient::USE::FETCH_TRANSACTIONS_ETH>();
+template bool ApiClient::hasNewActivity<ApiClient::USE::FETCH_TRANSACTIONS_TRON>();
+template bool ApiClient::hasNewActivity<ApiClient::USE::FETCH_TRANSACTIONS_SOL>();
 template std::string ApiClient::sendGETRequest<ApiClient::USE::FETCH_TRANSACTIONS_ETH>();
 template std::string ApiClient::sendGETRequest<ApiClient::USE::FETCH_SANCTIONS>();
 template std::string ApiClient::sendPOSTRequest<ApiClient::USE::FETCH_TRANSACTIONS_TRON>();
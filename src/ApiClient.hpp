@@ -3,33 +3,61 @@
 #define API_CLIENT_HPP
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <functional>
 #include <vector>
 #include <string>
+#include <unordered_map>
 #include <utility>
 
 #include "AddressCache.hpp"
+#include "Async.hpp"
+#include "SingleFlight.hpp"
+#include "TransactionDedupe.hpp"
+#include "Transport.hpp"
+#include "WorkQueue.hpp"
 #include "dependencies/httplib.h"
 
 class ApiClient {
 public:
-    explicit ApiClient(const std::string& target);
-
     enum USE { FETCH_TRANSACTIONS_TRON, FETCH_TRANSACTIONS_SOL, FETCH_TRANSACTIONS_ETH, FETCH_SANCTIONS };
 
     struct URLs {
-        const std::string tron_url = "https://api.trongrid.io";
-        const std::string tron_endpoint = "/wallet/getaccount";
-        const std::string shyft_url = "https://rpc.shyft.to";
-        const std::string shyft_endpoint = "/?api_key=";
-        const std::string etherscan_url = "https://api.etherscan.io";
-        const std::string chainalysis_url = "https://public.chainalysis.com";
-        const std::string chainalysis_endpoint = "/api/v1/address/";
+        std::string tron_url = "https://api.trongrid.io";
+        std::string tron_endpoint = "/wallet/getaccount";
+        std::string shyft_url = "https://rpc.shyft.to";
+        std::string shyft_endpoint = "/?api_key=";
+        std::string etherscan_url = "https://api.etherscan.io";
+        std::string chainalysis_url = "https://public.chainalysis.com";
+        std::string chainalysis_endpoint = "/api/v1/address/";
     };
 
-    const static int OK = 200;
-    const static int BAD = 400;
+    explicit ApiClient(const std::string& target);
+
+    // point the client at other provider hosts, such as a local mock
+    ApiClient(const std::string& target, const URLs& urls);
+
+    constexpr static int OK = 200;
+    constexpr static int NOT_MODIFIED = 304;
+    constexpr static int BAD = 400;
+    constexpr static int NOT_FOUND = 404;
+    constexpr static int TOO_LARGE = 413;
+    constexpr static int TOO_MANY_REQUESTS = 429;
+
+    // network a fetch use case belongs to, for metrics and output
+    static constexpr const char* networkOf(USE u) {
+        return u == FETCH_TRANSACTIONS_ETH ? "ethereum"
+             : u == FETCH_TRANSACTIONS_TRON ? "tron"
+             : u == FETCH_TRANSACTIONS_SOL ? "solana"
+             : "sanctions";
+    }
 
     template<USE u>
     std::string sendGETRequest();
@@ -39,14 +67,268 @@ public:
 
     httplib::Result getCachedAddressResult(std::string address);
 
+    // run catch-up pages and sanctions batches as units on a shared queue instead of on private threads
+    void setWorkQueue(std::shared_ptr<WorkQueue> queue);
+
+    void setPriority(Priority priority);
+
+    // work this client splits off is queued fairly against other tenants' work
+    void setTenant(size_t tenant);
+
+    // the configured priority, or urgent while a recent sanctions hit is being followed up
+    Priority getPriority() const;
+
+    // cached verdicts about to outlive SANCTIONS_TTL, most recently used first
+    static std::vector<std::string> expiringVerdicts(size_t limit);
+
+    // fetch and cache a fresh verdict for address ahead of its expiry
+    std::string refreshVerdict(const std::string& address);
+
+    // the result of a request that never went out, a background one given up for lack of tokens.
+    // unlike other errors it is worth trying again once the buckets refill
+    static bool isRefused(const std::string& result);
+
+    // queue the addresses eth targets send funds to for two-hop prefetching
+    static void setPrefetch(bool enabled);
+
+    // next first-hop address waiting to be prefetched and how often it was refused so far, false when there is none
+    static bool nextPrefetch(std::string& address, size_t& refusals);
+
+    // put back an address whose prefetch ran out of spare capacity, to be tried first next time. false when
+    // it was refused PREFETCH_MAX_REFUSALS times and is dropped instead
+    static bool deferPrefetch(const std::string& address, size_t refusals);
+
+    // warm the sanctions cache with the counterparties of this client's target, a first-hop address,
+    // so a later investigation one hop further out hits the cache
+    std::string prefetchSecondHops();
+
+    // how many recent transaction hashes each target, and the process as a whole, remembers
+    static void setDedupeWindow(size_t window);
+
+    // ask providers for whole transaction lists and account data again, instead of the minimal profiles
+    static void setFullPayloads(bool enabled);
+
+    // what every client sends its requests through, HttplibTransport unless set before the workers start
+    static void setTransport(std::shared_ptr<Transport> transport);
+
+    // cheap account-state check, true when the target changed since the last probe or the probe failed
+    template<USE u>
+    bool hasNewActivity();
+
+    // forget the last probed state so the next probe triggers a full fetch again
+    void resetActivityProbe();
+
+    // block range holding the target's history, from its first transaction to the chain head;
+    // NOT_FOUND when the target has no history at all
+    std::string fetchHistoryBounds(long long& firstBlock, long long& latestBlock);
+
+    // fetch every transaction in [startBlock, endBlock] and stage its counterparties for the sanctions sweep,
+    // TOO_LARGE when the range holds more than etherscan will page through
+    std::string fetchTransactionRange(long long startBlock, long long endBlock);
+
+#ifdef NETZ_COROUTINES
+    // the ethereum transaction fetch of sendGETRequest as a coroutine on loop, so a single loop thread keeps
+    // the requests of many targets in flight; shares cursor, dedupe and keys with the blocking calls
+    Async<std::string> fetchTransactions(EventLoop& loop);
+
+    // screen the counterparties staged by the last fetch, every lookup in flight at once
+    Async<std::string> screenCounterparties(EventLoop& loop);
+#endif
+
 private:
-    std::shared_ptr<AddressCache<std::string, httplib::Response>> cache;
+    struct Transaction {
+        std::string hash;
+        long long blockNumber;
+        std::string from;
+        std::string to;
+    };
+
+    // error, empty when the page came back fine, and the page's transactions
+    using CatchUpPage = std::pair<std::string, std::vector<Transaction>>;
+
+    // identical requests issued while one is already in flight share its response instead of going out again;
+    // operation names the call for its rate limit cost
+    httplib::Result sendGet(const std::string& host, const std::string& path, const std::string& operation,
+                            const httplib::Headers& headers = {});
+
+    httplib::Result sendPost(const std::string& host, const std::string& path, const std::string& operation,
+                             const httplib::Headers& headers, const std::string& body);
+
+    // one try at a request with the given key, cut short through the cancellation when another try answers first
+    using Attempt = std::function<httplib::Result(const std::string& key, WireStats& wire, Cancellation* cancellation)>;
+
+    // send the request on key, and once it has run longer than Hedging allows a duplicate on another key and
+    // connection, answering with whichever responds first
+    httplib::Result hedge(const std::string& host, const std::string& operation, const std::string& key,
+                          const Attempt& attempt);
+
+    // pick a key of the provider with tokens for the request, false when the drop policy turned it away
+    bool admit(const std::string& host, const std::string& operation, std::string& key) const;
+
+    static httplib::Headers withKey(const httplib::Headers& headers, const std::string& key);
+
+    // the provider refused the request because the key is over its own limit
+    static bool isKeyThrottled(const std::string& provider, const httplib::Result& res);
+
+    // account a provider response in the shared metrics, resting the key when it was throttled
+    httplib::Result countRequest(const std::string& host, const std::string& key, httplib::Result res,
+                                 const WireStats& wire);
+
+    std::string providerName(const std::string& host) const;
+
+    // share the result of an identical request already in flight at the same priority class
+    httplib::Result coalesce(const std::string& key, const std::function<httplib::Result()>& send) const;
+
+    struct Verdict {
+        bool sanctioned;
+        std::string body;
+        std::chrono::steady_clock::time_point fetched;
+    };
+
+    constexpr static size_t ETH_PAGE_SIZE = 10;
+    // how long a throttled key rests when the provider gives no Retry-After
+    constexpr static std::chrono::seconds KEY_COOLDOWN{30};
+    constexpr static size_t SANCTIONS_CACHE_CAPACITY = 50000;
+    // sanctions lists change, so a cached verdict is only trusted this long
+    constexpr static std::chrono::minutes SANCTIONS_TTL{60};
+    // verdicts this close to expiry are refreshed with spare capacity so a hit on them stays warm
+    constexpr static std::chrono::minutes SANCTIONS_REFRESH_AHEAD{10};
+    // recent transactions of a first hop whose counterparties are prefetched
+    constexpr static size_t PREFETCH_PAGE_SIZE = 25;
+    constexpr static size_t PREFETCH_QUEUE_CAPACITY = 1000;
+    // a first hop refused this often is given up, spare capacity that rarely shows up is better spent elsewhere
+    constexpr static size_t PREFETCH_MAX_REFUSALS = 5;
+    // first hops remembered so the same address isn't prefetched over and over
+    constexpr static size_t PREFETCH_SEEN_CAPACITY = 50000;
+    // how long a target stays urgent after screening turned up a sanctioned counterparty
+    constexpr static std::chrono::minutes SANCTIONS_FOLLOW_UP{30};
+    // etherscan rejects page * offset beyond this window
+    constexpr static int ETH_MAX_RESULT_WINDOW = 10000;
+    constexpr static size_t ETH_BACKFILL_PAGE_SIZE = 1000;
+    // catch-up pages requested ahead of knowing whether an earlier one reaches the cursor
+    constexpr static size_t ETH_CATCH_UP_WAVE_SIZE = 5;
+
+    static std::vector<Transaction> parseTransactions(const std::string& body);
+
+    // first value of "key" in a flat json body, quoted or bare
+    static std::string extractValue(const std::string& body, const std::string& key);
+
+    // fnv-1a, only used to spot byte-identical bodies
+    static uint64_t fingerprint(const std::string& body);
+
+    // true when body matches the last one seen on endpoint, remembering it either way
+    bool isUnchangedBody(const std::string& endpoint, const std::string& body);
+
+    // etherscan reports rate limiting and bad keys with a 200 and a string result
+    static bool isTransactionList(const std::string& body);
+
+    std::string transactionPagePath(int page, size_t offset = ETH_PAGE_SIZE, long long startBlock = 0,
+                                    long long endBlock = 99999999, const std::string& sort = "desc") const;
+
+    httplib::Result fetchTransactionPage(int page, size_t offset = ETH_PAGE_SIZE, long long startBlock = 0,
+                                         long long endBlock = 99999999, const std::string& sort = "desc");
+
+    // status to end the poll with, or empty with the first page's transactions when the poll goes on
+    std::string readFirstPage(const httplib::Result& res, std::vector<Transaction>& transactions);
+
+    // the first page is full and still newer than the cursor, so older pages hold more new transactions
+    bool needsCatchUp(const std::vector<Transaction>& transactions) const;
+
+    CatchUpPage readCatchUpPage(const httplib::Result& res);
+
+    // append the page's transactions newer than the cursor, true once the page reached it
+    bool takeCatchUpPage(const CatchUpPage& page, std::vector<Transaction>& transactions, bool& failed);
+
+    // advance the cursor past a poll's transactions and stage the counterparties of the unseen ones
+    std::string ingestTransactions(const std::vector<Transaction>& transactions, bool failed);
+
+    void stageCounterparties(const std::vector<Transaction>& transactions);
+
+    // drop transactions this target, or any other watched target, has already processed
+    std::vector<Transaction> filterSeen(const std::vector<Transaction>& transactions);
+
+    std::vector<Transaction> fetchCatchUpPages(bool& failed);
+
+    // first block a poll asks etherscan for: the cursor's, so an unchanged history isn't sent again
+    long long pollStartBlock() const;
+
+    bool isNewerThanCursor(const Transaction& tx) const;
+
+    void advanceCursor(const std::vector<Transaction>& transactions);
+
+    void markSanctionedHit();
+
+    void queueFirstHops(const std::vector<Transaction>& transactions);
+
+    // ask chainalysis about address and cache the verdict
+    std::string fetchVerdict(const std::string& address, const httplib::Headers& headers, bool& sanctioned);
+
+    std::string storeVerdict(const std::string& address, const httplib::Result& res, bool& sanctioned);
+
+    // false when there is no verdict for address younger than SANCTIONS_TTL
+    bool cachedVerdict(const std::string& address, bool& sanctioned);
+
+    // result and verdict for one counterparty, from the cache when it is fresh
+    std::pair<std::string, bool> screenAddress(const std::string& address);
+
+    // whether a screenAddress result holds a verdict, fresh or cached
+    static bool isScreened(const std::string& result);
+
+    // what a counterparty screening reports, an error when any of its screens got no verdict
+    static std::string screeningResult(size_t failed, size_t screened);
+
+#ifdef NETZ_COROUTINES
+    // coroutines start lazily, so they take their arguments by value rather than refer to the caller's
+    Async<httplib::Result> sendGet(EventLoop& loop, std::string host, std::string path, std::string operation,
+                                   httplib::Headers headers = {});
+
+    Async<std::pair<std::string, bool>> screenAddress(EventLoop& loop, std::string address);
+#endif
+
+    // verdicts are shared by every target and network in the process
+    static std::shared_ptr<AddressCache<std::string, Verdict>> sanctions_cache;
+    static std::mutex sanctions_cache_mutex;
+
+    std::shared_ptr<WorkQueue> work_queue;
+
+    URLs urls;
 
     std::shared_ptr<std::vector<std::string>> transaction_addresses;
 
+    std::shared_ptr<TransactionDedupe> seen_transactions;
+
+    static SingleFlight<std::string, std::shared_ptr<const httplib::Result>> in_flight;
+
+    static std::shared_ptr<Transport> transport;
+
+    static size_t dedupe_window;
+    static std::shared_ptr<TransactionDedupe> global_seen_transactions;
+
+    static bool full_payloads;
+
+    static bool prefetch_enabled;
+    // first hops with how often each was refused for lack of tokens
+    static std::deque<std::pair<std::string, size_t>> prefetch_queue;
+    static AddressCache<std::string, bool> prefetch_seen;
+    static std::mutex prefetch_mutex;
+
     std::string target;
 
-    std::string errorToString(httplib::Error err);
+    Priority priority = Priority::NORMAL;
+    size_t tenant = 0;
+    // steady clock ticks of the last sanctioned counterparty, 0 for none, written by whichever worker screened it
+    std::atomic<std::chrono::steady_clock::rep> last_sanctioned_hit{std::chrono::steady_clock::rep(0)};
+
+    // newest block seen so far and the hashes seen in it; -1 until the first page lands
+    long long cursor_block = -1;
+    std::set<std::string> cursor_hashes;
+
+    std::string probe_state;
+    bool has_probe_state = false;
+
+    std::unordered_map<std::string, uint64_t> body_fingerprints;
+
+    static std::string errorToString(httplib::Error err);
 };
 
 #endif
\ No newline at end of file
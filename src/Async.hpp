@@ -0,0 +1,197 @@
+#pragma once
+#ifndef ASYNC_HPP
+#define ASYNC_HPP
+
+#include "EventLoop.hpp"
+
+// the coroutine api needs c++20 and the event loop; other builds keep the blocking api only
+#if defined(NETZ_EVENT_LOOP) && defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define NETZ_COROUTINES 1
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// a coroutine producing a T, started when first awaited. it resumes on whichever thread completes what it
+// awaits, which for requests and sleeps is the event loop thread
+template<typename T>
+class Async {
+public:
+    struct promise_type {
+        std::optional<T> value;
+        std::exception_ptr error;
+        std::coroutine_handle<> continuation = std::noop_coroutine();
+
+        struct Final {
+            bool await_ready() const noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                return handle.promise().continuation;
+            }
+            void await_resume() const noexcept {}
+        };
+
+        Async get_return_object() { return Async(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        Final final_suspend() const noexcept { return {}; }
+        template<typename U>
+        void return_value(U&& result) { value.emplace(std::forward<U>(result)); }
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    Async(Async&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Async& operator=(Async&&) = delete;
+
+    ~Async() {
+        if (handle) handle.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    T await_resume() {
+        if (handle.promise().error) std::rethrow_exception(handle.promise().error);
+        return std::move(*handle.promise().value);
+    }
+
+    // run task to completion without awaiting it and hand its result to done, or what it threw to failed.
+    // without failed, the error is written to stderr and dropped
+    static void start(Async task, std::function<void(T)> done,
+                      std::function<void(std::exception_ptr)> failed = nullptr) {
+        drive(std::move(task), std::move(done), std::move(failed));
+    }
+
+private:
+    // owns itself and frees its frame when done
+    struct Detached {
+        struct promise_type {
+            Detached get_return_object() const noexcept { return {}; }
+            std::suspend_never initial_suspend() const noexcept { return {}; }
+            std::suspend_never final_suspend() const noexcept { return {}; }
+            void return_void() const noexcept {}
+            // only done or failed themselves throwing gets here, the task's own errors are caught in drive
+            void unhandled_exception() const noexcept { std::terminate(); }
+        };
+    };
+
+    static Detached drive(Async task, std::function<void(T)> done, std::function<void(std::exception_ptr)> failed) {
+        std::optional<T> result;
+        std::exception_ptr error;
+        try {
+            result.emplace(co_await task);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        if (!error) {
+            done(std::move(*result));
+        } else if (failed) {
+            failed(error);
+        } else {
+            /* a detached task has no one to rethrow to, ending the process over it would take every other one down */
+            try {
+                std::rethrow_exception(error);
+            } catch (const std::exception& e) {
+                std::cerr << "Async task failed: " << e.what() << std::endl;
+            } catch (...) {
+                std::cerr << "Async task failed" << std::endl;
+            }
+        }
+    }
+
+    explicit Async(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+// co_await Fetch{loop, request} sends request on loop and resumes on the loop thread with its result
+struct Fetch {
+    Fetch(EventLoop& loop, EventLoop::Request request) : loop(loop), request(std::move(request)) {}
+
+    EventLoop& loop;
+    EventLoop::Request request;
+    httplib::Result result;
+    // what the response took on the wire, once it is in
+    WireStats wire;
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> awaiting) {
+        loop.send(std::move(request), [this, awaiting](httplib::Result res, const WireStats& stats) {
+            result = std::move(res);
+            wire = stats;
+            awaiting.resume();
+        });
+    }
+
+    httplib::Result await_resume() { return std::move(result); }
+};
+
+// co_await Sleep{loop, seconds} resumes on the loop thread once seconds have passed, without holding a thread
+struct Sleep {
+    EventLoop& loop;
+    double seconds;
+
+    bool await_ready() const noexcept { return seconds <= 0; }
+
+    void await_suspend(std::coroutine_handle<> awaiting) {
+        loop.after(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds)),
+                   [awaiting]() { awaiting.resume(); });
+    }
+
+    void await_resume() const noexcept {}
+};
+
+// co_await WhenAll<T>{tasks} runs every task at once and resumes with their results, in task order,
+// once the last one is in. when a task throws, the others still run to the end and the first error is rethrown
+template<typename T>
+struct WhenAll {
+    explicit WhenAll(std::vector<Async<T>> tasks) : tasks(std::move(tasks)) {}
+
+    std::vector<Async<T>> tasks;
+    std::vector<std::optional<T>> results;
+    // tasks may finish on the loop thread while later ones are still being started
+    std::atomic<size_t> remaining{0};
+    std::coroutine_handle<> awaiting = nullptr;
+    // the first error a task threw, set by whichever thread claims failed first
+    std::exception_ptr error;
+    std::atomic<bool> failed{false};
+
+    bool await_ready() const noexcept { return tasks.empty(); }
+
+    bool await_suspend(std::coroutine_handle<> awaiting) {
+        this->awaiting = awaiting;
+        results.resize(tasks.size());
+        /* the extra count keeps a task finishing early from resuming us before every task is started */
+        remaining = tasks.size() + 1;
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            Async<T>::start(std::move(tasks[i]), [this, i](T result) {
+                results[i].emplace(std::move(result));
+                if (0 == --remaining) this->awaiting.resume();
+            }, [this](std::exception_ptr thrown) {
+                if (!failed.exchange(true)) error = thrown;
+                if (0 == --remaining) this->awaiting.resume();
+            });
+        }
+        return 0 != --remaining;
+    }
+
+    std::vector<T> await_resume() {
+        if (error) std::rethrow_exception(error);
+        std::vector<T> values;
+        values.reserve(results.size());
+        for (auto& result : results) values.push_back(std::move(*result));
+        return values;
+    }
+};
+
+#endif
+
+#endif
@@ -0,0 +1,70 @@
+#include <cstdio>
+#include <sstream>
+
+#include "BackfillCheckpoint.hpp"
+
+/*
+ * checkpoint file layout:
+ *   <target> <firstBlock> <lastBlock> <chunkSize>
+ *   done <chunk>
+ *   done <chunk>
+ *   ...
+ */
+BackfillCheckpoint::BackfillCheckpoint(const std::string& target, long long chunkSize)
+    : path("netz_backfill_" + target + ".ckpt"), target(target), chunkSize(chunkSize) {}
+
+bool BackfillCheckpoint::load(long long& firstBlock, long long& lastBlock) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string header;
+    if (!std::getline(in, header)) return false;
+    std::istringstream header_stream(header);
+    std::string saved_target;
+    long long saved_chunk_size = 0;
+    if (!(header_stream >> saved_target >> firstBlock >> lastBlock >> saved_chunk_size)) return false;
+    /* a checkpoint cut with a different chunk size numbers its chunks differently */
+    if (saved_target != target || saved_chunk_size != chunkSize) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream line_stream(line);
+        std::string tag;
+        size_t chunk;
+        if (line_stream >> tag >> chunk && tag == "done") done.insert(chunk);
+    }
+    out.open(path, std::ios::app);
+    return true;
+}
+
+void BackfillCheckpoint::begin(long long firstBlock, long long lastBlock) {
+    std::lock_guard<std::mutex> lock(mutex);
+    done.clear();
+    out.open(path, std::ios::trunc);
+    out << target << " " << firstBlock << " " << lastBlock << " " << chunkSize << std::endl;
+}
+
+bool BackfillCheckpoint::isDone(size_t chunk) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return done.find(chunk) != done.end();
+}
+
+void BackfillCheckpoint::markDone(size_t chunk) {
+    std::lock_guard<std::mutex> lock(mutex);
+    done.insert(chunk);
+    out << "done " << chunk << std::endl;
+}
+
+size_t BackfillCheckpoint::doneCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return done.size();
+}
+
+void BackfillCheckpoint::finish() {
+    std::lock_guard<std::mutex> lock(mutex);
+    out.close();
+    std::remove(path.c_str());
+}
+
+const std::string& BackfillCheckpoint::getPath() const {
+    return path;
+}
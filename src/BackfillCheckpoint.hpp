@@ -0,0 +1,41 @@
+#pragma once
+#ifndef BACKFILL_CHECKPOINT_HPP
+#define BACKFILL_CHECKPOINT_HPP
+
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <string>
+
+class BackfillCheckpoint {
+public:
+    BackfillCheckpoint(const std::string& target, long long chunkSize);
+
+    // restore block range and finished chunks from a previous run, false if there is none to resume
+    bool load(long long& firstBlock, long long& lastBlock);
+
+    // start a fresh checkpoint for the given block range
+    void begin(long long firstBlock, long long lastBlock);
+
+    bool isDone(size_t chunk);
+
+    // durably record a finished chunk
+    void markDone(size_t chunk);
+
+    size_t doneCount();
+
+    // drop the checkpoint once the whole range has been screened
+    void finish();
+
+    const std::string& getPath() const;
+
+private:
+    std::string path;
+    std::string target;
+    long long chunkSize;
+    std::set<size_t> done;
+    std::ofstream out;
+    std::mutex mutex;
+};
+
+#endif
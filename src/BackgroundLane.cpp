@@ -0,0 +1,45 @@
+#include <thread>
+
+#include "BackgroundLane.hpp"
+#include "Metrics.hpp"
+
+BackgroundLane::BackgroundLane(std::shared_ptr<WorkQueue> queue) : queue(queue) {}
+
+void BackgroundLane::addJob(const std::string& name, Job job) {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back({name, job, std::chrono::steady_clock::now()});
+}
+
+void BackgroundLane::run(const std::atomic<bool>& active) {
+    while (active.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        /* one step at a time keeps at most one worker off real-time work, and only when none was waiting */
+        if (step_running.load() || 0 != queue->size()) continue;
+        std::lock_guard<std::mutex> lock(mutex);
+        auto now = std::chrono::steady_clock::now();
+        for (size_t tried = 0; tried < jobs.size(); ++tried) {
+            size_t index = next;
+            next = (next + 1) % jobs.size();
+            if (jobs[index].resume > now) continue;
+            step_running.store(true);
+            queue->push([this, index]() {
+                Step step = STARVED;
+                try {
+                    step = jobs[index].job();
+                } catch (...) {
+                    step_running.store(false);
+                    throw;
+                }
+                Metrics::Counters& metrics = Metrics::get("background " + jobs[index].name);
+                metrics.polls++;
+                if (IDLE == step) metrics.idlePolls++;
+                if (STARVED == step) metrics.starvedSteps++;
+                std::lock_guard<std::mutex> lock(mutex);
+                auto done = std::chrono::steady_clock::now();
+                jobs[index].resume = MORE == step ? done : done + (IDLE == step ? IDLE_DELAY : STARVED_DELAY);
+                step_running.store(false);
+            }, Priority::BACKGROUND);
+            break;
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+#ifndef BACKGROUND_LANE_HPP
+#define BACKGROUND_LANE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "WorkQueue.hpp"
+
+class BackgroundLane {
+public:
+    // what a job's step achieved: more to do, nothing to do for now, or no spare tokens to do it with
+    enum Step { MORE, IDLE, STARVED };
+
+    // one short unit of a job; it should issue background priority requests, which give up rather than wait long
+    using Job = std::function<Step()>;
+
+    explicit BackgroundLane(std::shared_ptr<WorkQueue> queue);
+
+    void addJob(const std::string& name, Job job);
+
+    // while active, hand one step at a time, taking the jobs in turn, to the queue's background lane,
+    // and only while no other work is waiting for the workers
+    void run(const std::atomic<bool>& active);
+
+private:
+    struct Entry {
+        std::string name;
+        Job job;
+        std::chrono::steady_clock::time_point resume;
+    };
+
+    static constexpr std::chrono::seconds IDLE_DELAY{30};
+    static constexpr std::chrono::seconds STARVED_DELAY{5};
+
+    std::shared_ptr<WorkQueue> queue;
+    std::vector<Entry> jobs;
+    size_t next = 0;
+    std::atomic<bool> step_running{false};
+    std::mutex mutex;
+};
+
+#endif
@@ -1,8 +1,9 @@
-#include <cctype>
+#include <cstdlib>
 #include <iostream>
-#include <map>
-#include <algorithm>
+#include <set>
+#include <stdexcept>
 
+#include "AddressValidator.hpp"
 #include "CliClient.hpp"
 
 int CliClient::parseIntArg(const char* arg, const std::string& flagName) {
@@ -15,46 +16,47 @@ int CliClient::parseIntArg(const char* arg, const std::string& flagName) {
     }
 }
 
+CliClient::RateSpec CliClient::parseRateSpec(const std::string& spec, const std::string& flagName) {
+    size_t eq = spec.find('=');
+    if (eq == std::string::npos || 0 == eq) {
+        throw std::runtime_error("Error: --" + flagName + " expects provider=rate[/burst], got '" + spec + "'");
+    }
+    RateSpec rate_spec{spec.substr(0, eq), 0, 0};
+    CliClient::isKnownProvider(rate_spec.provider, flagName);
+    size_t slash = spec.find('/', eq);
+    try {
+        rate_spec.rate = std::stod(spec.substr(eq + 1, slash == std::string::npos ? std::string::npos : slash - eq - 1));
+        if (slash != std::string::npos) rate_spec.burst = std::stod(spec.substr(slash + 1));
+    } catch (const std::exception&) {
+        throw std::runtime_error("Error: Invalid number in --" + flagName + " '" + spec + "'");
+    }
+    if (rate_spec.rate <= 0 || rate_spec.burst < 0) {
+        throw std::runtime_error("Error: --" + flagName + " rate must be positive.");
+    }
+    return rate_spec;
+}
+
+bool CliClient::isKnownProvider(const std::string& provider, const std::string& flagName) {
+    /* a misspelt provider would otherwise set a bucket nothing ever draws from, and the limit silently not apply */
+    static const std::set<std::string> providers = {"etherscan", "trongrid", "shyft", "chainalysis"};
+    if (0 == providers.count(provider)) {
+        throw std::runtime_error("Error: Unknown provider '" + provider + "' in --" + flagName
+                                 + ".\nOptions: etherscan, trongrid, shyft, chainalysis");
+    }
+    return true;
+}
+
 bool CliClient::isValidNetwork(std::string& network) {
-    std::vector<std::string> valid_networks = {
-        "tron",
-        "solana",
-        "ethereum"
-    };
-     std::transform(network.begin(), network.end(), network.begin(), ::tolower);
-     auto found = std::find(std::begin(valid_networks), std::end(valid_networks), network);
-     if (found == valid_networks.end()) throw std::runtime_error("Error: Network " + network + " is not a valid network.\nOptions: tron, solana, ethereum");
-     return true;
+    const std::string& canonical = AddressValidator::canonicalNetwork(network);
+    if (canonical.empty()) throw std::runtime_error("Error: Network " + network + " is not a valid network.\nOptions: tron, solana, ethereum");
+    network = canonical;
+    return true;
 }
 
 bool CliClient::isValidAddress(std::string& target, std::string& network) {
-    std::map<std::string, std::function<bool(std::string&)>> nw_map;
-    nw_map["tron"] = [](std::string& target) {
-        const size_t tron_size = 34;
-        return tron_size == target.length() && std::to_string(target[0]) == "T";
-    };
-    nw_map["solana"] = [](std::string& target) {
-        const size_t min_size = 32;
-        const size_t max_size = 44;
-        if (min_size > target.length() || max_size < target.length()) return false;
-        auto isValidBase58Char = [](char c) {
-            const std::string base58_alphabet = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
-            return base58_alphabet.find(c) != std::string::npos;
-        };
-        return std::all_of(target.begin(), target.end(), isValidBase58Char);
-    };
-    nw_map["ethereum"] = [](std::string& target) {
-        const size_t eth_size = 42;
-        if (target.length() != eth_size) return false;
-        if (target.substr(0, 2) != "0x") return false;
-        auto isValidHexChar = [](char c) {
-            return std::isxdigit(c);
-        };
-        return std::all_of(target.begin() + 2, target.end(), isValidHexChar);
-    };
-    auto it = nw_map.find(network);
-    if (it == nw_map.end()) throw std::runtime_error("Error: Unknown network " + network);
-    if (!it->second(target)) throw std::runtime_error("Error: Invalid address " + target + " for network " + network);
+    const std::string& canonical = AddressValidator::canonicalNetwork(network);
+    if (canonical.empty()) throw std::runtime_error("Error: Unknown network " + network);
+    if (!AddressValidator::isValid(canonical, target)) throw std::runtime_error("Error: Invalid address " + target + " for network " + network);
     return true;
 }
 
@@ -100,7 +102,8 @@ void CliClient::printBanner(std::string& target, std::string& network, int &numT
     std::cout << "====================================================" << std::endl;
 }
 
-void CliClient::parseArguments(int argc, char* argv[], int& numThreads, std::string& target, std::string& network) {
+void CliClient::parseArguments(int argc, char* argv[], Options& options) {
+    bool network_given = false;
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
         try {
@@ -111,21 +114,138 @@ void CliClient::parseArguments(int argc, char* argv[], int& numThreads, std::str
                 if (i + 1 >= argc) {
                     throw std::runtime_error("Error: --threads requires a value");
                 }
-                numThreads = CliClient::parseIntArg(argv[++i], "threads");
+                options.numThreads = CliClient::parseIntArg(argv[++i], "threads");
             } else if (arg == "--network" || arg == "-nw") {
                 if (i + 1 >= argc) {
                     throw std::runtime_error("Error: --network requires a value");
                 }
-                network = std::string(argv[++i]);
-                CliClient::isValidNetwork(network);
+                options.network = std::string(argv[++i]);
+                CliClient::isValidNetwork(options.network);
+                network_given = true;
             } else if (arg == "--target" || arg == "-ta") {
                 if (i + 1 >= argc) {
                     throw std::runtime_error("Error: --target requires a value");
                 }
-                target = std::string(argv[++i]);
-                if (!network.empty()) {
-                    CliClient::isValidAddress(target, network);
+                std::string target = std::string(argv[++i]);
+                if (network_given) {
+                    CliClient::isValidAddress(target, options.network);
+                }
+                /* a target given before any --network takes the last one, as it always has */
+                options.targets.push_back({network_given ? options.network : "", target});
+                if (options.target.empty()) options.target = target;
+            } else if (arg == "--verbose" || arg == "-v") {
+                options.verbose = true;
+            } else if (arg == "--backfill" || arg == "-bf") {
+                options.backfill = true;
+            } else if (arg == "--background-backfill" || arg == "-bb") {
+                options.backgroundBackfill = true;
+            } else if (arg == "--prefetch" || arg == "-pf") {
+                options.prefetch = true;
+            } else if (arg == "--http2" || arg == "-h2") {
+                options.http2 = true;
+            } else if (arg == "--full-payloads" || arg == "-fp") {
+                options.fullPayloads = true;
+            } else if (arg == "--watchlist" || arg == "-wl") {
+                if (i + 1 >= argc) {
+                    throw std::runtime_error("Error: --watchlist requires a value");
+                }
+                std::string spec = std::string(argv[++i]);
+                size_t eq = spec.find('=');
+                if (eq != std::string::npos && 0 < eq && spec.find('/') > eq) {
+                    options.watchlists.push_back({spec.substr(0, eq), spec.substr(eq + 1)});
+                } else {
+                    options.watchlists.push_back({"default", spec});
+                }
+            } else if (arg == "--tenant-weight" || arg == "-tw") {
+                if (i + 1 >= argc) {
+                    throw std::runtime_error("Error: --tenant-weight requires a value");
+                }
+                std::string spec = std::string(argv[++i]);
+                size_t eq = spec.find('=');
+                if (eq == std::string::npos || 0 == eq) {
+                    throw std::runtime_error("Error: --tenant-weight expects tenant=weight, got '" + spec + "'");
+                }
+                double weight;
+                try {
+                    weight = std::stod(spec.substr(eq + 1));
+                } catch (const std::exception&) {
+                    throw std::runtime_error("Error: Invalid number in --tenant-weight '" + spec + "'");
+                }
+                if (weight <= 0) throw std::runtime_error("Error: --tenant-weight must be positive.");
+                options.tenantWeights[spec.substr(0, eq)] = weight;
+            } else if (arg == "--dedupe-window" || arg == "-dw") {
+                if (i + 1 >= argc) {
+                    throw std::runtime_error("Error: --dedupe-window requires a value");
+                }
+                int window = CliClient::parseIntArg(argv[++i], "dedupe-window");
+                if (window <= 0) throw std::runtime_error("Error: --dedupe-window must be a positive integer.");
+                options.dedupeWindow = static_cast<size_t>(window);
+            } else if (arg == "--hedge" || arg == "-hg") {
+                if (i + 1 >= argc) {
+                    throw std::runtime_error("Error: --hedge requires a value");
+                }
+                options.hedgePercentile = CliClient::parseIntArg(argv[++i], "hedge");
+                if (options.hedgePercentile <= 0 || options.hedgePercentile >= 100) {
+                    throw std::runtime_error("Error: --hedge must be a percentile between 1 and 99.");
+                }
+            } else if (arg == "--hedge-budget" || arg == "-hb") {
+                if (i + 1 >= argc) {
+                    throw std::runtime_error("Error: --hedge-budget requires a value");
+                }
+                options.hedgeBudgetPercent = CliClient::parseIntArg(argv[++i], "hedge-budget");
+                if (options.hedgeBudgetPercent <= 0 || options.hedgeBudgetPercent > 100) {
+                    throw std::runtime_error("Error: --hedge-budget must be a percentage between 1 and 100.");
                 }
+            } else if (arg == "--poll-min" || arg == "-pmin") {
+                if (i + 1 >= argc) {
+                    throw std::runtime_error("Error: --poll-min requires a value");
+                }
+                options.minPollMs = CliClient::parseIntArg(argv[++i], "poll-min");
+                if (options.minPollMs <= 0) throw std::runtime_error("Error: --poll-min must be a positive integer.");
+            } else if (arg == "--poll-max" || arg == "-pmax") {
+                if (i + 1 >= argc) {
+                    throw std::runtime_error("Error: --poll-max requires a value");
+                }
+                options.maxPollMs = CliClient::parseIntArg(argv[++i], "poll-max");
+                if (options.maxPollMs <= 0) throw std::runtime_error("Error: --poll-max must be a positive integer.");
+            } else if (arg == "--rate-limit" || arg == "-rl") {
+                if (i + 1 >= argc) {
+                    throw std::runtime_error("Error: --rate-limit requires a value");
+                }
+                options.keyRates.push_back(CliClient::parseRateSpec(argv[++i], "rate-limit"));
+            } else if (arg == "--provider-limit" || arg == "-pl") {
+                if (i + 1 >= argc) {
+                    throw std::runtime_error("Error: --provider-limit requires a value");
+                }
+                options.providerRates.push_back(CliClient::parseRateSpec(argv[++i], "provider-limit"));
+            } else if (arg == "--request-cost" || arg == "-rc") {
+                if (i + 1 >= argc) {
+                    throw std::runtime_error("Error: --request-cost requires a value");
+                }
+                std::string spec = std::string(argv[++i]);
+                size_t colon = spec.find(':');
+                size_t eq = spec.find('=');
+                if (colon == std::string::npos || eq == std::string::npos || eq < colon) {
+                    throw std::runtime_error("Error: --request-cost expects provider:operation=tokens, got '" + spec + "'");
+                }
+                double cost;
+                try {
+                    cost = std::stod(spec.substr(eq + 1));
+                } catch (const std::exception&) {
+                    throw std::runtime_error("Error: Invalid number in --request-cost '" + spec + "'");
+                }
+                if (cost < 0) throw std::runtime_error("Error: --request-cost must not be negative.");
+                CliClient::isKnownProvider(spec.substr(0, colon), "request-cost");
+                options.requestCosts.push_back({spec.substr(0, eq), cost});
+            } else if (arg == "--rate-policy" || arg == "-rp") {
+                if (i + 1 >= argc) {
+                    throw std::runtime_error("Error: --rate-policy requires a value");
+                }
+                std::string policy = std::string(argv[++i]);
+                if (policy != "wait" && policy != "drop") {
+                    throw std::runtime_error("Error: --rate-policy must be wait or drop.");
+                }
+                options.dropWhenLimited = policy == "drop";
             } else {
                 throw std::runtime_error("Error: Unknown option '" + arg + "'. Use --help for usage.");
             }
@@ -134,7 +254,52 @@ void CliClient::parseArguments(int argc, char* argv[], int& numThreads, std::str
             std::exit(EXIT_FAILURE);
         }
     }
-    if (!target.empty() && !network.empty()) CliClient::isValidAddress(target, network);
+    try {
+        std::set<std::pair<std::string, std::string>> seen;
+        std::vector<std::pair<std::string, std::string>> unique;
+        for (auto& [network, target] : options.targets) {
+            if (network.empty()) network = options.network;
+            CliClient::isValidAddress(target, network);
+            /* the same forms a watchlist is reduced to, so a target given twice in any case is polled once */
+            target = AddressValidator::canonicalAddress(network, target);
+            if (seen.insert({network, target}).second) unique.emplace_back(network, target);
+        }
+        options.targets = std::move(unique);
+        if (!options.targets.empty()) options.target = options.targets.front().second;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+        std::exit(EXIT_FAILURE);
+    }
+    std::set<std::string> tenants;
+    for (const auto& watchlist : options.watchlists) tenants.insert(watchlist.first);
+    for (const auto& weight : options.tenantWeights) {
+        /* a misspelt tenant would otherwise leave the one meant at the default weight without a word */
+        if (0 == tenants.count(weight.first)) {
+            std::cerr << "Error: --tenant-weight names tenant '" << weight.first << "', which no --watchlist is given for"
+                      << '\n';
+            std::exit(EXIT_FAILURE);
+        }
+    }
+    if (options.minPollMs > options.maxPollMs) {
+        std::cerr << "Error: --poll-min must not exceed --poll-max" << '\n';
+        std::exit(EXIT_FAILURE);
+    }
+    if (options.backfill && options.targets.size() > 1) {
+        std::cerr << "Error: --backfill takes a single --target" << '\n';
+        std::exit(EXIT_FAILURE);
+    }
+    if (options.backfill && options.network != "ethereum") {
+        std::cerr << "Error: --backfill is only supported on ethereum" << '\n';
+        std::exit(EXIT_FAILURE);
+    }
+    if (options.backfill && options.backgroundBackfill) {
+        std::cerr << "Error: --background-backfill runs alongside monitoring, not with --backfill" << '\n';
+        std::exit(EXIT_FAILURE);
+    }
+    if (options.backfill && !options.watchlists.empty()) {
+        std::cerr << "Error: --backfill takes a single --target, not a --watchlist" << '\n';
+        std::exit(EXIT_FAILURE);
+    }
 }
 
 void CliClient::displayHelp() {
@@ -143,8 +308,31 @@ void CliClient::displayHelp() {
               << "  -h, --help                Show this help message\n"
               << "  -th, --threads [num]      Number of threads to run (default: 1)\n"
               << "  -nw, --network [nw]       Blockchain network (tron/solana/ethereum)\n"
-              << "  -ta, --target [addr]      Target address to monitor\n"
+              << "  -ta, --target [addr]      Target address to monitor, repeatable after each --network\n"
+              << "  -wl, --watchlist [file]   Monitor every \"<network> <address>\" line of a file, repeatable;\n"
+              << "                            tenant=file watches the file's targets for that tenant\n"
+              << "  -tw, --tenant-weight [t=w] Share of workers and api keys tenant t gets under contention (default: 1)\n"
               << "  -v, --verbose             Enable verbose output\n"
+              << "  -bf, --backfill           Screen the target's full history, then exit (ethereum)\n"
+              << "  -bb, --background-backfill Screen watched ethereum targets' history with spare rate limit budget\n"
+              << "  -pf, --prefetch           Screen who the addresses a target pays paid in turn, with spare budget\n"
+              << "  -h2, --http2              Multiplex provider requests over one http/2 connection per host\n"
+              << "  -fp, --full-payloads      Fetch whole transaction lists and account data, not just what is new\n"
+              << "  -dw, --dedupe-window [n]  Recent transactions remembered to suppress repeats (default: 10000)\n"
+              << "  -hg, --hedge [p]          Duplicate a request still out after the p-th percentile of recent ones\n"
+              << "  -hb, --hedge-budget [%]   Most duplicates --hedge sends, per 100 requests answered (default: 5)\n"
+              << "  -pmin, --poll-min [ms]    Poll interval right after a target shows activity (default: 5000)\n"
+              << "  -pmax, --poll-max [ms]    Longest interval an idle target backs off to (default: 300000)\n"
+              << "  -rl, --rate-limit [spec]  provider=rate[/burst] per api key, repeatable\n"
+              << "  -pl, --provider-limit [spec] provider=rate[/burst] across all keys of a provider\n"
+              << "  -rc, --request-cost [spec] provider:operation=tokens one call costs (default: 1)\n"
+              << "  -rp, --rate-policy [p]    wait for tokens or drop the request when limited (default: wait)\n"
+              << "\nProviders: etherscan, trongrid, shyft, chainalysis\n"
               << "\nExample: \n"
-              << "./netz --threads 4 --network ethereum --target 0x123abc...\n";
+              << "./netz --threads 4 --network ethereum --target 0x123abc...\n"
+              << "./netz --threads 4 --backfill --target 0x123abc...\n"
+              << "./netz --threads 16 --watchlist targets.txt\n"
+              << "./netz --network ethereum --target 0x123abc... --network tron --target T9yD14...\n"
+              << "./netz --watchlist targets.txt --rate-limit etherscan=10 --request-cost etherscan:txlist=2\n"
+              << "./netz --watchlist alerts=alerts.txt --watchlist research=history.txt --tenant-weight alerts=4\n";
 }
\ No newline at end of file
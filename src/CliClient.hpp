@@ -2,19 +2,66 @@
 #ifndef CLI_CLIENT_HPP
 #define CLI_CLIENT_HPP
 
+#include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 class CliClient {
 public:
+    // tokens per second and bucket size for one provider, burst 0 meaning one second's worth
+    struct RateSpec {
+        std::string provider;
+        double rate;
+        double burst;
+    };
+
+    struct Options {
+        int numThreads = 1;
+        std::string target = "";
+        std::string network = "ethereum";
+        // every --target with the --network given before it, so one run can mix networks
+        std::vector<std::pair<std::string, std::string>> targets;
+        bool verbose = false;
+        bool backfill = false;
+        // screen the history of watched ethereum targets with leftover rate limit budget while monitoring
+        bool backgroundBackfill = false;
+        // warm the sanctions cache with the counterparties of addresses targets pay, using spare capacity
+        bool prefetch = false;
+        size_t dedupeWindow = 10000;
+        // tenant and path of every --watchlist, the tenant being "default" unless given as tenant=path
+        std::vector<std::pair<std::string, std::string>> watchlists;
+        std::map<std::string, double> tenantWeights;
+        std::vector<RateSpec> keyRates;
+        std::vector<RateSpec> providerRates;
+        // "provider:operation" and the tokens one call of it costs
+        std::vector<std::pair<std::string, double>> requestCosts;
+        bool dropWhenLimited = false;
+        // send provider requests over http/2 through libcurl, in builds that have it
+        bool http2 = false;
+        // ask providers for whole transaction lists and account data rather than the minimal request profiles
+        bool fullPayloads = false;
+        // percentile of recent latency after which a slow request is sent again, 0 for no hedging
+        int hedgePercentile = 0;
+        int hedgeBudgetPercent = 5;
+        int minPollMs = 5000;
+        int maxPollMs = 300000;
+    };
+
     static int parseIntArg(const char* arg, const std::string& flagName);
 
-    static void parseArguments(int argc, char* argv[], int& numThreads, std::string& target, std::string& network);
+    // "provider=rate[/burst]"
+    static RateSpec parseRateSpec(const std::string& spec, const std::string& flagName);
+
+    static void parseArguments(int argc, char* argv[], Options& options);
 
     static void printBanner(std::string& target, std::string& network, int &numThreads);
 
     static void displayHelp();
 
+    // one of the providers requests go to, throws naming flagName otherwise
+    static bool isKnownProvider(const std::string& provider, const std::string& flagName);
+
     static bool isValidNetwork(std::string& network);
 
     static bool isValidAddress(std::string& target, std::string& network);
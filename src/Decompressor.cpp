@@ -0,0 +1,144 @@
+#include "Decompressor.hpp"
+
+#include <algorithm>
+#include <zlib.h>
+
+#ifdef NETZ_BROTLI
+#include <brotli/decode.h>
+#endif
+
+namespace {
+
+const size_t OUTPUT_CHUNK = 16384;
+
+std::string normalized(const std::string& contentEncoding) {
+    std::string encoding = contentEncoding;
+    encoding.erase(std::remove_if(encoding.begin(), encoding.end(), ::isspace), encoding.end());
+    std::transform(encoding.begin(), encoding.end(), encoding.begin(), ::tolower);
+    return encoding;
+}
+
+}
+
+struct Decompressor::State {
+    bool brotli = false;
+    bool done = false;
+    z_stream zlib{};
+#ifdef NETZ_BROTLI
+    BrotliDecoderState* decoder = nullptr;
+#endif
+
+    ~State() {
+        if (!brotli) inflateEnd(&zlib);
+#ifdef NETZ_BROTLI
+        if (decoder) BrotliDecoderDestroyInstance(decoder);
+#endif
+    }
+};
+
+std::unique_ptr<Decompressor> Decompressor::create(const std::string& contentEncoding) {
+    const std::string encoding = normalized(contentEncoding);
+    auto state = std::make_unique<State>();
+    if ("gzip" == encoding || "x-gzip" == encoding || "deflate" == encoding) {
+        /* 32 on top of the window bits has zlib tell a gzip header from a zlib one */
+        if (Z_OK != inflateInit2(&state->zlib, 15 + 32)) return nullptr;
+        return std::unique_ptr<Decompressor>(new Decompressor(std::move(state)));
+    }
+#ifdef NETZ_BROTLI
+    if ("br" == encoding) {
+        state->brotli = true;
+        state->decoder = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+        if (!state->decoder) return nullptr;
+        return std::unique_ptr<Decompressor>(new Decompressor(std::move(state)));
+    }
+#endif
+    return nullptr;
+}
+
+bool Decompressor::isIdentity(const std::string& contentEncoding) {
+    const std::string encoding = normalized(contentEncoding);
+    return encoding.empty() || "identity" == encoding;
+}
+
+const std::string& Decompressor::acceptEncoding() {
+#ifdef NETZ_BROTLI
+    static const std::string encodings = "br, gzip, deflate";
+#else
+    static const std::string encodings = "gzip, deflate";
+#endif
+    return encodings;
+}
+
+bool Decompressor::decodeBody(httplib::Response& response, WireStats& wire) {
+    wire.bytes += static_cast<long long>(response.body.size());
+    const std::string encoding = response.get_header_value("Content-Encoding");
+    if (isIdentity(encoding)) return true;
+    std::unique_ptr<Decompressor> decompressor = create(encoding);
+    if (!decompressor) return false;
+    std::string body;
+    bool decoded = decompressor->feed(response.body.data(), response.body.size(), body) && decompressor->finished();
+    wire.decoding += decompressor->elapsed();
+    if (!decoded) return false;
+    response.body = std::move(body);
+    response.headers.erase("Content-Encoding");
+    return true;
+}
+
+Decompressor::Decompressor(std::unique_ptr<State> state) : state(std::move(state)) {}
+
+Decompressor::~Decompressor() = default;
+
+bool Decompressor::feed(const char* data, size_t size, std::string& out) {
+    if (state->done) return true;
+    auto started = std::chrono::steady_clock::now();
+    char buffer[OUTPUT_CHUNK];
+    bool ok = true;
+    if (!state->brotli) {
+        z_stream& zlib = state->zlib;
+        zlib.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        zlib.avail_in = static_cast<uInt>(size);
+        /* keep going while there is input left or the last round filled the buffer, which may leave output behind */
+        do {
+            zlib.next_out = reinterpret_cast<Bytef*>(buffer);
+            zlib.avail_out = sizeof(buffer);
+            int status = inflate(&zlib, Z_NO_FLUSH);
+            out.append(buffer, sizeof(buffer) - zlib.avail_out);
+            if (Z_STREAM_END == status) {
+                state->done = true;
+                break;
+            }
+            if (Z_BUF_ERROR == status) break;
+            if (Z_OK != status) {
+                ok = false;
+                break;
+            }
+        } while (zlib.avail_in > 0 || 0 == zlib.avail_out);
+    }
+#ifdef NETZ_BROTLI
+    else {
+        const uint8_t* next_in = reinterpret_cast<const uint8_t*>(data);
+        size_t available_in = size;
+        while (true) {
+            uint8_t* next_out = reinterpret_cast<uint8_t*>(buffer);
+            size_t available_out = sizeof(buffer);
+            BrotliDecoderResult result = BrotliDecoderDecompressStream(state->decoder, &available_in, &next_in,
+                                                                       &available_out, &next_out, nullptr);
+            out.append(buffer, sizeof(buffer) - available_out);
+            if (BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT == result) continue;
+            if (BROTLI_DECODER_RESULT_SUCCESS == result) state->done = true;
+            if (BROTLI_DECODER_RESULT_ERROR == result) ok = false;
+            break;
+        }
+    }
+#endif
+    busy += std::chrono::steady_clock::now() - started;
+    return ok;
+}
+
+bool Decompressor::finished() const {
+    return state->done;
+}
+
+std::chrono::microseconds Decompressor::elapsed() const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(busy);
+}
@@ -0,0 +1,56 @@
+#pragma once
+#ifndef DECOMPRESSOR_HPP
+#define DECOMPRESSOR_HPP
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "dependencies/httplib.h"
+
+// what a response took to receive: its body as it came off the wire, and the time spent decoding it
+struct WireStats {
+    long long bytes = 0;
+    std::chrono::microseconds decoding{0};
+};
+
+// decodes a compressed response body piece by piece as it arrives, so the compressed body is never held whole.
+// gzip and deflate always, brotli in builds with -DNETZ_BROTLI and -lbrotlidec
+class Decompressor {
+public:
+    // nullptr for an identity body, or an encoding this build doesn't decode
+    static std::unique_ptr<Decompressor> create(const std::string& contentEncoding);
+
+    // the body went out as is
+    static bool isIdentity(const std::string& contentEncoding);
+
+    // Accept-Encoding for provider requests, the encodings create() takes
+    static const std::string& acceptEncoding();
+
+    // decode a body received whole, in place, with wire counting the bytes received; false when it is corrupt
+    static bool decodeBody(httplib::Response& response, WireStats& wire);
+
+    ~Decompressor();
+
+    Decompressor(const Decompressor&) = delete;
+    Decompressor& operator=(const Decompressor&) = delete;
+
+    // append what the next piece of the body decodes to onto out, false once the stream turns out corrupt
+    bool feed(const char* data, size_t size, std::string& out);
+
+    // true once the compressed stream has ended
+    bool finished() const;
+
+    // time spent in feed so far
+    std::chrono::microseconds elapsed() const;
+
+private:
+    struct State;
+
+    explicit Decompressor(std::unique_ptr<State> state);
+
+    std::unique_ptr<State> state;
+    std::chrono::steady_clock::duration busy{0};
+};
+
+#endif
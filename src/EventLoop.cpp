@@ -0,0 +1,884 @@
+#include "EventLoop.hpp"
+
+#ifdef NETZ_EVENT_LOOP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "Resolver.hpp"
+
+struct EventLoop::Connection {
+    int fd = -1;
+    std::string origin;
+    // authority as sent in the Host header
+    std::string authority;
+    // the host's name, the address connected to, and how many addresses the name has
+    std::string name;
+    std::string address;
+    size_t addresses = 0;
+    SSL* ssl = nullptr;
+    BIO* rbio = nullptr;
+    BIO* wbio = nullptr;
+    bool connected = false;
+    bool handshaken = false;
+    // connected, and done with the tls handshake where there is one
+    bool ready = false;
+    bool reused = false;
+    bool eof = false;
+    uint32_t interest = 0;
+    std::chrono::steady_clock::time_point deadline;
+#ifdef NETZ_IO_URING
+    uint64_t serial = 0;
+    // ids of the ring operations in flight on the socket, 0 for none
+    uint64_t connect_op = 0;
+    uint64_t receive_op = 0;
+    uint64_t send_op = 0;
+#endif
+
+    // bytes waiting for the socket, tls records included
+    std::string outbox;
+    size_t sent = 0;
+    // plaintext read so far and how far the parser got through it
+    std::string inbox;
+    size_t cursor = 0;
+
+    std::unique_ptr<Exchange> exchange;
+    bool request_written = false;
+
+    std::unique_ptr<httplib::Response> response;
+    long long content_length = -1;
+    bool chunked = false;
+    bool keep_alive = true;
+    enum { CHUNK_SIZE, CHUNK_DATA, CHUNK_END, TRAILER } chunk_state = CHUNK_SIZE;
+    size_t chunk_left = 0;
+    std::unique_ptr<Decompressor> decompressor;
+    // the body came in an encoding that can't be decoded, or didn't decode
+    bool undecodable = false;
+    WireStats wire;
+
+    void reset() {
+        outbox.clear();
+        sent = 0;
+        inbox.clear();
+        cursor = 0;
+        request_written = false;
+        response.reset();
+        content_length = -1;
+        chunked = false;
+        keep_alive = true;
+        chunk_state = CHUNK_SIZE;
+        chunk_left = 0;
+        decompressor.reset();
+        undecodable = false;
+        wire = WireStats{};
+    }
+};
+
+namespace {
+
+const size_t READ_BUFFER_SIZE = 16384;
+#ifdef NETZ_IO_URING
+const unsigned RING_ENTRIES = 256;
+const size_t RING_BUFFERS = 256;
+#endif
+const int NO_CONTENT = 204;
+const int NOT_MODIFIED = 304;
+
+std::string lower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+    return text;
+}
+
+std::string trim(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t");
+    if (begin == std::string::npos) return "";
+    return text.substr(begin, text.find_last_not_of(" \t") - begin + 1);
+}
+
+}
+
+EventLoop::EventLoop() {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd < 0 || wake_fd < 0) throw std::runtime_error("Error: Could not set up the event loop.");
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = wake_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+
+    /* same trust as httplib::Client: the system's ca store, with the host name checked per connection */
+    tls_context = SSL_CTX_new(TLS_client_method());
+    if (!tls_context) throw std::runtime_error("Error: Could not set up tls for the event loop.");
+    SSL_CTX_set_default_verify_paths(tls_context);
+    SSL_CTX_set_verify(tls_context, SSL_VERIFY_PEER, nullptr);
+
+#ifdef NETZ_IO_URING
+    /* without a ring, say under a seccomp profile that blocks it, the loop stays on epoll */
+    ring = IoUring::create(RING_ENTRIES, RING_BUFFERS, READ_BUFFER_SIZE);
+    if (ring) armWake();
+#endif
+}
+
+EventLoop::~EventLoop() {
+    stopped = true;
+    waiting.clear();
+    while (!connections.empty()) close(*connections.begin()->second);
+#ifdef NETZ_IO_URING
+    /* the kernel writes into the registered buffers until each operation completes, so wait them out */
+    if (ring && wake_op) cancel(wake_op);
+    for (int round = 0; ring && !operations.empty() && round < 100; ++round) {
+        ring->submitAndWait(std::chrono::milliseconds(10));
+        ring->forEachCompletion([this](uint64_t id, int result) { onCompletion(id, result); });
+    }
+#endif
+    SSL_CTX_free(tls_context);
+    ::close(wake_fd);
+    ::close(epoll_fd);
+}
+
+void EventLoop::send(Request request, Callback done) {
+    in_flight++;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued.push_back(std::make_unique<Exchange>(Exchange{std::move(request), std::move(done)}));
+    }
+    uint64_t one = 1;
+    (void) !write(wake_fd, &one, sizeof(one));
+}
+
+void EventLoop::after(std::chrono::steady_clock::duration delay, std::function<void()> fn) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        timers.emplace(std::chrono::steady_clock::now() + delay, std::move(fn));
+    }
+    uint64_t one = 1;
+    (void) !write(wake_fd, &one, sizeof(one));
+}
+
+void EventLoop::stop() {
+    stopped = true;
+    uint64_t one = 1;
+    (void) !write(wake_fd, &one, sizeof(one));
+}
+
+size_t EventLoop::inFlight() const {
+    return in_flight.load();
+}
+
+const char* EventLoop::backend() const {
+#ifdef NETZ_IO_URING
+    if (ring) return "io_uring";
+#endif
+    return "epoll";
+}
+
+void EventLoop::run() {
+    epoll_event events[64];
+    while (!stopped) {
+        int timeout = 1000;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!timers.empty()) {
+                auto until = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        timers.begin()->first - std::chrono::steady_clock::now()).count();
+                timeout = static_cast<int>(std::max<long long>(0, std::min<long long>(timeout, until + 1)));
+            }
+        }
+#ifdef NETZ_IO_URING
+        if (ring) {
+            /* everything queued since the last round goes to the kernel in this one syscall */
+            ring->submitAndWait(std::chrono::milliseconds(timeout));
+            ring->forEachCompletion([this](uint64_t id, int result) { onCompletion(id, result); });
+            if (starved) {
+                starved = false;
+                for (auto& [fd, connection] : connections) arm(*connection);
+            }
+            runQueued();
+            runTimers();
+            sweepDeadlines();
+            continue;
+        }
+#endif
+        int count = epoll_wait(epoll_fd, events, 64, timeout);
+        for (int i = 0; i < count; ++i) {
+            if (wake_fd == events[i].data.fd) {
+                uint64_t wakes;
+                (void) !read(wake_fd, &wakes, sizeof(wakes));
+                continue;
+            }
+            auto it = connections.find(events[i].data.fd);
+            if (it != connections.end()) onEvents(*it->second, events[i].events);
+        }
+        runQueued();
+        runTimers();
+        sweepDeadlines();
+    }
+    /* start() turns new work away once stopped, so this drains */
+    runQueued();
+    std::vector<int> open;
+    for (const auto& [fd, connection] : connections) open.push_back(fd);
+    for (int fd : open) {
+        auto it = connections.find(fd);
+        if (it != connections.end()) fail(*it->second, httplib::Error::Canceled);
+    }
+    for (auto& [origin, exchanges] : waiting) {
+        while (!exchanges.empty()) {
+            std::unique_ptr<Exchange> exchange = std::move(exchanges.front());
+            exchanges.pop_front();
+            finish(std::move(exchange), httplib::Result(nullptr, httplib::Error::Canceled));
+        }
+    }
+}
+
+void EventLoop::runQueued() {
+    std::vector<std::unique_ptr<Exchange>> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.swap(queued);
+    }
+    for (auto& exchange : ready) start(std::move(exchange));
+}
+
+void EventLoop::runTimers() {
+    std::vector<std::function<void()>> due;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto now = std::chrono::steady_clock::now();
+        while (!timers.empty() && timers.begin()->first <= now) {
+            due.push_back(std::move(timers.begin()->second));
+            timers.erase(timers.begin());
+        }
+    }
+    for (auto& fn : due) fn();
+}
+
+void EventLoop::sweepDeadlines() {
+    auto now = std::chrono::steady_clock::now();
+    std::vector<int> expired;
+    for (const auto& [fd, connection] : connections) {
+        if (connection->deadline < now) expired.push_back(fd);
+    }
+    for (int fd : expired) {
+        auto it = connections.find(fd);
+        if (it == connections.end()) continue;
+        Connection& connection = *it->second;
+        if (!connection.exchange) close(connection);
+        else fail(connection, connection.connected ? httplib::Error::Read : httplib::Error::ConnectionTimeout);
+    }
+}
+
+void EventLoop::dispatch(const std::string& origin) {
+    auto queue = waiting.find(origin);
+    if (queue == waiting.end() || queue->second.empty()) return;
+    std::unique_ptr<Exchange> exchange = std::move(queue->second.front());
+    queue->second.pop_front();
+    start(std::move(exchange));
+}
+
+void EventLoop::start(std::unique_ptr<Exchange> exchange) {
+    if (stopped) {
+        finish(std::move(exchange), httplib::Result(nullptr, httplib::Error::Canceled));
+        return;
+    }
+    const std::string& origin = exchange->request.host;
+    Connection* connection = nullptr;
+    auto pool = idle.find(origin);
+    if (pool != idle.end() && !pool->second.empty()) {
+        connection = pool->second.back();
+        pool->second.pop_back();
+        connection->reused = true;
+    } else if (open_connections[origin] < MAX_CONNECTIONS_PER_HOST && connecting[origin] < MAX_CONNECTING_PER_HOST) {
+        connection = open(origin);
+    } else {
+        waiting[origin].push_back(std::move(exchange));
+        return;
+    }
+    if (!connection) {
+        finish(std::move(exchange), httplib::Result(nullptr, httplib::Error::Connection));
+        return;
+    }
+    connection->exchange = std::move(exchange);
+    connection->deadline = std::chrono::steady_clock::now() + TIMEOUT;
+    advance(*connection);
+}
+
+EventLoop::Connection* EventLoop::open(const std::string& origin) {
+    const bool tls = 0 == origin.rfind("https://", 0);
+    size_t scheme_end = origin.find("://");
+    std::string authority = scheme_end == std::string::npos ? origin : origin.substr(scheme_end + 3);
+    std::string name = authority;
+    std::string port = tls ? "443" : "80";
+    size_t colon = authority.rfind(':');
+    if (colon != std::string::npos && authority.find(']') == std::string::npos) {
+        name = authority.substr(0, colon);
+        port = authority.substr(colon + 1);
+    }
+    /* through the process-wide Resolver, so only a name's first lookup blocks the loop */
+    const std::vector<std::string> addresses = Resolver::lookup(name);
+    Address address;
+    std::string numeric;
+    int fd = -1;
+    int flags = SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC;
+#ifdef NETZ_IO_URING
+    /* the ring waits for readiness itself, only epoll needs the socket non-blocking */
+    if (ring) flags &= ~SOCK_NONBLOCK;
+#endif
+    for (const std::string& candidate : addresses) {
+        if (!parseAddress(candidate, port, address)) continue;
+        fd = socket(address.storage.ss_family, flags, 0);
+        if (fd < 0) return nullptr;
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (
+#ifdef NETZ_IO_URING
+            ring ||
+#endif
+            connect(fd, reinterpret_cast<const sockaddr*>(&address.storage), address.length) >= 0 || EINPROGRESS == errno) {
+            numeric = candidate;
+            break;
+        }
+        /* an unreachable address, say ipv6 on a host without a route, fails on the spot, so the next one is tried */
+        ::close(fd);
+        fd = -1;
+        Resolver::demote(name, candidate);
+    }
+    if (fd < 0) return nullptr;
+
+    auto connection = std::make_unique<Connection>();
+    connection->fd = fd;
+    connection->origin = origin;
+    connection->authority = authority;
+    connection->name = name;
+    connection->address = numeric;
+    connection->addresses = addresses.size();
+    if (tls) {
+        /* tls runs over memory bios, so the socket side stays the same plain byte shuffling as http */
+        connection->ssl = SSL_new(tls_context);
+        connection->rbio = BIO_new(BIO_s_mem());
+        connection->wbio = BIO_new(BIO_s_mem());
+        SSL_set_bio(connection->ssl, connection->rbio, connection->wbio);
+        SSL_set_connect_state(connection->ssl);
+        SSL_set_tlsext_host_name(connection->ssl, name.c_str());
+        SSL_set1_host(connection->ssl, name.c_str());
+    }
+    Connection* raw = connection.get();
+    connections[fd] = std::move(connection);
+    open_connections[origin]++;
+    connecting[origin]++;
+#ifdef NETZ_IO_URING
+    if (ring) {
+        connectRing(*raw, address);
+        return raw;
+    }
+#endif
+    epoll_event event{};
+    event.events = raw->interest = EPOLLIN | EPOLLOUT;
+    event.data.fd = fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    return raw;
+}
+
+bool EventLoop::parseAddress(const std::string& numeric, const std::string& port, Address& address) {
+    /* a numeric address and port only get parsed, they never reach the resolver */
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+    addrinfo* result = nullptr;
+    if (0 != getaddrinfo(numeric.c_str(), port.c_str(), &hints, &result) || !result) return false;
+    std::copy_n(reinterpret_cast<const char*>(result->ai_addr), result->ai_addrlen,
+                reinterpret_cast<char*>(&address.storage));
+    address.length = result->ai_addrlen;
+    freeaddrinfo(result);
+    return true;
+}
+
+void EventLoop::onEvents(Connection& connection, uint32_t events) {
+    if (!connection.connected) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(connection.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+        if (0 != error) {
+            failConnect(connection);
+            return;
+        }
+        if (!(events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) return;
+        connection.connected = true;
+    }
+    if (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) readSocket(connection);
+    advance(connection);
+}
+
+void EventLoop::readSocket(Connection& connection) {
+    char buffer[READ_BUFFER_SIZE];
+    while (true) {
+        ssize_t n = recv(connection.fd, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+            if (connection.ssl) BIO_write(connection.rbio, buffer, static_cast<int>(n));
+            else connection.inbox.append(buffer, static_cast<size_t>(n));
+            if (connection.exchange) connection.deadline = std::chrono::steady_clock::now() + TIMEOUT;
+            continue;
+        }
+        if (n < 0 && EINTR == errno) continue;
+        if (n < 0 && (EAGAIN == errno || EWOULDBLOCK == errno)) break;
+        connection.eof = true;
+        return;
+    }
+    /* the kernel falls back to delayed acks after a while, which stalls servers that write a response in pieces */
+    int one = 1;
+    setsockopt(connection.fd, IPPROTO_TCP, TCP_QUICKACK, &one, sizeof(one));
+}
+
+void EventLoop::advance(Connection& connection) {
+    if (!connection.connected) return;
+    if (connection.ssl && !connection.handshaken) {
+        int status = SSL_do_handshake(connection.ssl);
+        if (1 == status) {
+            connection.handshaken = true;
+        } else {
+            int error = SSL_get_error(connection.ssl, status);
+            if (SSL_ERROR_WANT_READ != error && SSL_ERROR_WANT_WRITE != error) {
+                fail(connection, X509_V_OK != SSL_get_verify_result(connection.ssl)
+                                 ? httplib::Error::SSLServerVerification : httplib::Error::SSLConnection);
+                return;
+            }
+        }
+    }
+    if (!connection.ready && (!connection.ssl || connection.handshaken)) {
+        connection.ready = true;
+        connecting[connection.origin]--;
+        /* room for another connection to the host to start its handshake */
+        dispatch(connection.origin);
+    }
+    if (connection.ready && connection.exchange && !connection.request_written) {
+        const Request& request = connection.exchange->request;
+        std::string text = request.method + " " + request.path + " HTTP/1.1\r\nHost: " + connection.authority + "\r\n";
+        for (const auto& [name, value] : request.headers) text += name + ": " + value + "\r\n";
+        if (0 == request.headers.count("Accept")) text += "Accept: */*\r\n";
+        if (!request.body.empty() || "POST" == request.method) {
+            text += "Content-Length: " + std::to_string(request.body.size()) + "\r\n";
+        }
+        text += "\r\n" + request.body;
+        if (!connection.ssl) {
+            connection.outbox += text;
+        } else if (SSL_write(connection.ssl, text.data(), static_cast<int>(text.size())) <= 0) {
+            fail(connection, httplib::Error::Write);
+            return;
+        }
+        connection.request_written = true;
+    }
+    if (connection.ssl && connection.handshaken) {
+        char buffer[READ_BUFFER_SIZE];
+        while (true) {
+            int n = SSL_read(connection.ssl, buffer, sizeof(buffer));
+            if (n > 0) {
+                connection.inbox.append(buffer, static_cast<size_t>(n));
+                continue;
+            }
+            int error = SSL_get_error(connection.ssl, n);
+            if (SSL_ERROR_WANT_READ != error && SSL_ERROR_WANT_WRITE != error) connection.eof = true;
+            break;
+        }
+    }
+    if (connection.ssl) drainTls(connection);
+
+    if (!connection.exchange) {
+        /* an idle connection has nothing to say, anything it reads means the server is done with it */
+        if (connection.eof || !connection.inbox.empty()) close(connection);
+        else watch(connection);
+        return;
+    }
+    if (connection.request_written && parse(connection)) {
+        complete(connection);
+        return;
+    }
+    if (connection.undecodable) {
+        fail(connection, httplib::Error::Compression);
+        return;
+    }
+    if (connection.eof) {
+        fail(connection, httplib::Error::Read);
+        return;
+    }
+    if (!flush(connection)) {
+        fail(connection, httplib::Error::Write);
+        return;
+    }
+    watch(connection);
+}
+
+void EventLoop::drainTls(Connection& connection) {
+    char buffer[READ_BUFFER_SIZE];
+    while (BIO_ctrl_pending(connection.wbio) > 0) {
+        int n = BIO_read(connection.wbio, buffer, sizeof(buffer));
+        if (n <= 0) break;
+        connection.outbox.append(buffer, static_cast<size_t>(n));
+    }
+}
+
+bool EventLoop::flush(Connection& connection) {
+#ifdef NETZ_IO_URING
+    /* the ring sends from arm() */
+    if (ring) return true;
+#endif
+    while (connection.sent < connection.outbox.size()) {
+        ssize_t n = ::send(connection.fd, connection.outbox.data() + connection.sent,
+                           connection.outbox.size() - connection.sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            connection.sent += static_cast<size_t>(n);
+            connection.deadline = std::chrono::steady_clock::now() + TIMEOUT;
+            continue;
+        }
+        if (n < 0 && EINTR == errno) continue;
+        if (n < 0 && (EAGAIN == errno || EWOULDBLOCK == errno)) return true;
+        return false;
+    }
+    connection.outbox.clear();
+    connection.sent = 0;
+    return true;
+}
+
+void EventLoop::watch(Connection& connection) {
+#ifdef NETZ_IO_URING
+    if (ring) {
+        arm(connection);
+        return;
+    }
+#endif
+    uint32_t interest = EPOLLIN;
+    if (!connection.connected || connection.sent < connection.outbox.size()) interest |= EPOLLOUT;
+    if (interest == connection.interest) return;
+    epoll_event event{};
+    event.events = connection.interest = interest;
+    event.data.fd = connection.fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, connection.fd, &event);
+}
+
+bool EventLoop::parse(Connection& connection) {
+    std::string& inbox = connection.inbox;
+    while (!connection.response) {
+        size_t end = inbox.find("\r\n\r\n", connection.cursor);
+        if (end == std::string::npos) return false;
+        auto response = std::make_unique<httplib::Response>();
+        size_t line_end = inbox.find("\r\n", connection.cursor);
+        std::string status_line = inbox.substr(connection.cursor, line_end - connection.cursor);
+        size_t space = status_line.find(' ');
+        if (space == std::string::npos) {
+            connection.eof = true;
+            return false;
+        }
+        response->version = status_line.substr(0, space);
+        response->status = std::atoi(status_line.c_str() + space + 1);
+        size_t reason = status_line.find(' ', space + 1);
+        if (reason != std::string::npos) response->reason = status_line.substr(reason + 1);
+        for (size_t pos = line_end + 2; pos < end;) {
+            size_t eol = inbox.find("\r\n", pos);
+            std::string line = inbox.substr(pos, eol - pos);
+            pos = eol + 2;
+            size_t colon = line.find(':');
+            if (colon != std::string::npos) response->headers.emplace(trim(line.substr(0, colon)), trim(line.substr(colon + 1)));
+        }
+        connection.cursor = end + 4;
+        /* interim responses carry no body and are followed by the real one */
+        if (response->status >= 100 && response->status < 200) continue;
+
+        connection.chunked = std::string::npos != lower(response->get_header_value("Transfer-Encoding")).find("chunked");
+        if (response->has_header("Content-Length")) {
+            connection.content_length = std::atoll(response->get_header_value("Content-Length").c_str());
+        }
+        if (NO_CONTENT == response->status || NOT_MODIFIED == response->status ||
+            "HEAD" == connection.exchange->request.method) {
+            connection.chunked = false;
+            connection.content_length = 0;
+        }
+        connection.keep_alive = "HTTP/1.1" == response->version &&
+                                "close" != lower(response->get_header_value("Connection"));
+        const std::string encoding = response->get_header_value("Content-Encoding");
+        if (!Decompressor::isIdentity(encoding)) {
+            connection.decompressor = Decompressor::create(encoding);
+            if (!connection.decompressor) {
+                connection.undecodable = true;
+                return false;
+            }
+        }
+        connection.response = std::move(response);
+    }
+
+    if (connection.chunked) {
+        while (true) {
+            if (Connection::CHUNK_SIZE == connection.chunk_state) {
+                size_t eol = inbox.find("\r\n", connection.cursor);
+                if (eol == std::string::npos) return false;
+                connection.chunk_left = std::strtoul(inbox.c_str() + connection.cursor, nullptr, 16);
+                connection.cursor = eol + 2;
+                connection.chunk_state = 0 == connection.chunk_left ? Connection::TRAILER : Connection::CHUNK_DATA;
+            } else if (Connection::CHUNK_DATA == connection.chunk_state) {
+                size_t take = std::min(connection.chunk_left, inbox.size() - connection.cursor);
+                takeBody(connection, take);
+                if (connection.undecodable) return false;
+                connection.chunk_left -= take;
+                if (0 != connection.chunk_left) return false;
+                connection.chunk_state = Connection::CHUNK_END;
+            } else if (Connection::CHUNK_END == connection.chunk_state) {
+                if (inbox.size() - connection.cursor < 2) return false;
+                connection.cursor += 2;
+                connection.chunk_state = Connection::CHUNK_SIZE;
+            } else {
+                size_t eol = inbox.find("\r\n", connection.cursor);
+                if (eol == std::string::npos) return false;
+                bool last = eol == connection.cursor;
+                connection.cursor = eol + 2;
+                if (last) return finishBody(connection);
+            }
+        }
+    }
+    if (connection.content_length >= 0) {
+        /* content_length counts down what is still to come */
+        size_t take = std::min(static_cast<size_t>(connection.content_length), inbox.size() - connection.cursor);
+        takeBody(connection, take);
+        connection.content_length -= static_cast<long long>(take);
+        return 0 == connection.content_length && finishBody(connection);
+    }
+    /* without a length the body runs until the server closes */
+    takeBody(connection, inbox.size() - connection.cursor);
+    if (!connection.eof) return false;
+    connection.keep_alive = false;
+    return finishBody(connection);
+}
+
+void EventLoop::takeBody(Connection& connection, size_t length) {
+    std::string& body = connection.response->body;
+    const char* data = connection.inbox.data() + connection.cursor;
+    connection.wire.bytes += static_cast<long long>(length);
+    if (!connection.decompressor) body.append(data, length);
+    else if (!connection.decompressor->feed(data, length, body)) connection.undecodable = true;
+    connection.cursor += length;
+    /* the body only ever grows in the response, so the inbox doesn't hold a second copy of it */
+    connection.inbox.erase(0, connection.cursor);
+    connection.cursor = 0;
+}
+
+bool EventLoop::finishBody(Connection& connection) {
+    /* a 304 or a HEAD may name the encoding without sending a body to decode */
+    if (!connection.decompressor || 0 == connection.wire.bytes) return !connection.undecodable;
+    connection.wire.decoding = connection.decompressor->elapsed();
+    if (connection.undecodable || !connection.decompressor->finished()) {
+        connection.undecodable = true;
+        return false;
+    }
+    connection.response->headers.erase("Content-Encoding");
+    return true;
+}
+
+void EventLoop::complete(Connection& connection) {
+    std::unique_ptr<Exchange> exchange = std::move(connection.exchange);
+    std::unique_ptr<httplib::Response> response = std::move(connection.response);
+    WireStats wire = connection.wire;
+    bool reusable = connection.keep_alive && !connection.eof && connection.cursor == connection.inbox.size();
+    std::deque<Connection*>& pool = idle[connection.origin];
+    if (reusable && pool.size() < MAX_IDLE_PER_HOST) {
+        connection.reset();
+        connection.deadline = std::chrono::steady_clock::now() + IDLE_TIMEOUT;
+        pool.push_back(&connection);
+        watch(connection);
+        dispatch(connection.origin);
+    } else {
+        close(connection);
+    }
+    finish(std::move(exchange), httplib::Result(std::move(response), httplib::Error::Success), wire);
+}
+
+void EventLoop::fail(Connection& connection, httplib::Error error) {
+    std::unique_ptr<Exchange> exchange = std::move(connection.exchange);
+    /* a kept-alive connection that dies before answering was most likely closed by the server while idle */
+    bool retry = exchange && connection.reused && connection.inbox.empty() && !exchange->retried && !stopped;
+    close(connection);
+    if (!exchange) return;
+    if (retry) {
+        exchange->retried = true;
+        start(std::move(exchange));
+        return;
+    }
+    finish(std::move(exchange), httplib::Result(nullptr, error));
+}
+
+void EventLoop::failConnect(Connection& connection) {
+    Resolver::demote(connection.name, connection.address);
+    std::unique_ptr<Exchange> exchange = std::move(connection.exchange);
+    size_t addresses = connection.addresses;
+    close(connection);
+    if (!exchange) return;
+    /* nothing went out on a socket that never connected, so the request may start over as is */
+    if (++exchange->failed_connects < addresses && !stopped) {
+        start(std::move(exchange));
+        return;
+    }
+    finish(std::move(exchange), httplib::Result(nullptr, httplib::Error::Connection));
+}
+
+void EventLoop::close(Connection& connection) {
+    auto pool = idle.find(connection.origin);
+    if (pool != idle.end()) {
+        pool->second.erase(std::remove(pool->second.begin(), pool->second.end(), &connection), pool->second.end());
+    }
+#ifdef NETZ_IO_URING
+    for (uint64_t id : {connection.connect_op, connection.receive_op, connection.send_op}) {
+        if (id) cancel(id);
+    }
+#endif
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, connection.fd, nullptr);
+    ::close(connection.fd);
+    if (connection.ssl) SSL_free(connection.ssl);
+    const std::string origin = connection.origin;
+    open_connections[origin]--;
+    if (!connection.ready) connecting[origin]--;
+    connections.erase(connection.fd);
+    dispatch(origin);
+}
+
+#ifdef NETZ_IO_URING
+uint64_t EventLoop::submit(io_uring_sqe* sqe, Operation op) {
+    uint64_t id = next_operation++;
+    sqe->user_data = id;
+    operations.emplace(id, op);
+    return id;
+}
+
+void EventLoop::connectRing(Connection& connection, const Address& address) {
+    connection.serial = next_serial++;
+    Operation op{Operation::CONNECT, connection.fd, connection.serial};
+    op.address = address;
+    io_uring_sqe* sqe = ring->next();
+    uint64_t id = submit(sqe, op);
+    sqe->opcode = IORING_OP_CONNECT;
+    sqe->fd = connection.fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&operations.at(id).address.storage);
+    sqe->off = address.length;
+    connection.connect_op = id;
+}
+
+void EventLoop::arm(Connection& connection) {
+    if (!connection.connected) return;
+    if (!connection.receive_op && !connection.eof) {
+        int buffer = ring->takeBuffer();
+        if (buffer < 0) {
+            starved = true;
+        } else {
+            io_uring_sqe* sqe = ring->next();
+            connection.receive_op = submit(sqe, Operation{Operation::RECEIVE, connection.fd, connection.serial, buffer});
+            sqe->opcode = IORING_OP_READ_FIXED;
+            sqe->fd = connection.fd;
+            sqe->addr = reinterpret_cast<uint64_t>(ring->buffer(buffer));
+            sqe->len = static_cast<uint32_t>(ring->bufferSize());
+            sqe->buf_index = static_cast<uint16_t>(buffer);
+        }
+    }
+    if (!connection.send_op && connection.sent < connection.outbox.size()) {
+        int buffer = ring->takeBuffer();
+        if (buffer < 0) {
+            starved = true;
+            return;
+        }
+        /* the outbox may grow while the send is in flight, so it goes out of a copy in the slab. a plain
+           send rather than WRITE_FIXED, since only send takes MSG_NOSIGNAL */
+        size_t length = std::min(ring->bufferSize(), connection.outbox.size() - connection.sent);
+        std::copy_n(connection.outbox.data() + connection.sent, length, ring->buffer(buffer));
+        io_uring_sqe* sqe = ring->next();
+        connection.send_op = submit(sqe, Operation{Operation::SEND, connection.fd, connection.serial, buffer});
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = connection.fd;
+        sqe->addr = reinterpret_cast<uint64_t>(ring->buffer(buffer));
+        sqe->len = static_cast<uint32_t>(length);
+        sqe->msg_flags = MSG_NOSIGNAL;
+    }
+}
+
+void EventLoop::armWake() {
+    io_uring_sqe* sqe = ring->next();
+    wake_op = submit(sqe, Operation{Operation::WAKE, wake_fd});
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = wake_fd;
+    sqe->poll32_events = POLLIN;
+}
+
+void EventLoop::cancel(uint64_t id) {
+    io_uring_sqe* sqe = ring->next();
+    /* id 0 is never handed out, so the cancel's own completion is dropped */
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = id;
+}
+
+void EventLoop::onCompletion(uint64_t id, int result) {
+    auto it = operations.find(id);
+    if (it == operations.end()) return;
+    Operation op = it->second;
+    operations.erase(it);
+    if (Operation::WAKE == op.kind) {
+        wake_op = 0;
+        if (-ECANCELED == result) return;
+        uint64_t wakes;
+        (void) !read(wake_fd, &wakes, sizeof(wakes));
+        armWake();
+        return;
+    }
+    auto found = connections.find(op.fd);
+    if (found == connections.end() || found->second->serial != op.serial) {
+        if (op.buffer >= 0) ring->releaseBuffer(op.buffer);
+        return;
+    }
+    Connection& connection = *found->second;
+    if (Operation::CONNECT == op.kind) {
+        connection.connect_op = 0;
+        if (result < 0) {
+            failConnect(connection);
+            return;
+        }
+        connection.connected = true;
+    } else if (Operation::RECEIVE == op.kind) {
+        connection.receive_op = 0;
+        if (result > 0) {
+            const char* data = ring->buffer(op.buffer);
+            if (connection.ssl) BIO_write(connection.rbio, data, result);
+            else connection.inbox.append(data, static_cast<size_t>(result));
+            if (connection.exchange) connection.deadline = std::chrono::steady_clock::now() + TIMEOUT;
+            /* delayed acks again, as in readSocket */
+            int one = 1;
+            setsockopt(connection.fd, IPPROTO_TCP, TCP_QUICKACK, &one, sizeof(one));
+        } else {
+            connection.eof = true;
+        }
+        ring->releaseBuffer(op.buffer);
+    } else {
+        connection.send_op = 0;
+        ring->releaseBuffer(op.buffer);
+        if (result < 0) {
+            fail(connection, httplib::Error::Write);
+            return;
+        }
+        /* a finished exchange may have reset the outbox under the send */
+        connection.sent = std::min(connection.sent + static_cast<size_t>(result), connection.outbox.size());
+        if (connection.sent == connection.outbox.size()) {
+            connection.outbox.clear();
+            connection.sent = 0;
+        }
+        connection.deadline = std::chrono::steady_clock::now() + TIMEOUT;
+    }
+    advance(connection);
+}
+#endif
+
+void EventLoop::finish(std::unique_ptr<Exchange> exchange, httplib::Result result, const WireStats& wire) {
+    in_flight--;
+    exchange->done(std::move(result), wire);
+}
+
+#endif
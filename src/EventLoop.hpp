@@ -0,0 +1,196 @@
+#pragma once
+#ifndef EVENT_LOOP_HPP
+#define EVENT_LOOP_HPP
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <openssl/ssl.h>
+#include <string>
+#include <sys/socket.h>
+#include <vector>
+
+#include "Decompressor.hpp"
+#include "IoUring.hpp"
+#include "dependencies/httplib.h"
+
+// built on epoll, so only linux gets the event loop and the coroutine api on top of it
+#ifdef __linux__
+#define NETZ_EVENT_LOOP 1
+
+// one thread keeping many outbound http(s) requests in flight over non-blocking sockets, with idle
+// connections kept alive per host. requests may be queued from any thread, callbacks run on the loop thread.
+// built with NETZ_IO_URING the sockets are driven through an io_uring instead of epoll where the kernel allows it
+class EventLoop {
+public:
+    struct Request {
+        std::string method;
+        // scheme://name[:port], as in ApiClient::URLs
+        std::string host;
+        std::string path;
+        httplib::Headers headers;
+        std::string body;
+    };
+
+    // the response, decoded, and what it took on the wire
+    using Callback = std::function<void(httplib::Result, const WireStats&)>;
+
+    EventLoop();
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // done runs on the loop thread once the response, or the error that ended the request, is in
+    void send(Request request, Callback done);
+
+    // run fn on the loop thread once delay has passed
+    void after(std::chrono::steady_clock::duration delay, std::function<void()> fn);
+
+    // serve requests on the calling thread until stop(), then fail whatever is still outstanding as canceled
+    void run();
+
+    void stop();
+
+    // requests sent whose callback has not run yet
+    size_t inFlight() const;
+
+    // "io_uring" or "epoll", whichever drives the sockets
+    const char* backend() const;
+
+    // longest a request may go without progress on its connection
+    constexpr static std::chrono::seconds TIMEOUT{30};
+    constexpr static std::chrono::seconds IDLE_TIMEOUT{30};
+    // requests beyond this many per host wait for one of its connections to come free
+    constexpr static size_t MAX_CONNECTIONS_PER_HOST = 32;
+    // connections a host has mid-handshake at once, so a burst of requests doesn't overflow its accept queue
+    constexpr static size_t MAX_CONNECTING_PER_HOST = 4;
+    constexpr static size_t MAX_IDLE_PER_HOST = 16;
+
+private:
+    struct Exchange {
+        Request request;
+        Callback done;
+        // a kept-alive connection the server had already closed gets one more try on a fresh one
+        bool retried = false;
+        // connects that failed so far, each one on the host's next address
+        size_t failed_connects = 0;
+    };
+
+    struct Connection;
+
+    struct Address {
+        sockaddr_storage storage;
+        socklen_t length;
+    };
+
+    void start(std::unique_ptr<Exchange> exchange);
+
+    // hand the next request waiting on origin to a connection that came free
+    void dispatch(const std::string& origin);
+
+    Connection* open(const std::string& origin);
+
+    // a numeric address from the process-wide Resolver and port as a socket address
+    static bool parseAddress(const std::string& numeric, const std::string& port, Address& address);
+
+    void onEvents(Connection& connection, uint32_t events);
+
+    // move bytes between the socket, tls and the response parser as far as they go without blocking
+    void advance(Connection& connection);
+
+    void readSocket(Connection& connection);
+
+    // false when the socket refused the bytes
+    bool flush(Connection& connection);
+
+    void drainTls(Connection& connection);
+
+    // true once the response on the connection is complete
+    bool parse(Connection& connection);
+
+    // hand length bytes of body at the parser's cursor to the response, decoding them on the way, and drop
+    // them from the inbox
+    void takeBody(Connection& connection, size_t length);
+
+    // true when the body decoded in full, or had no encoding
+    bool finishBody(Connection& connection);
+
+    void complete(Connection& connection);
+
+    void fail(Connection& connection, httplib::Error error);
+
+    // the connect failed: demote the address and start the request over on the host's next one, if it has one
+    void failConnect(Connection& connection);
+
+    void close(Connection& connection);
+
+    void watch(Connection& connection);
+
+    void finish(std::unique_ptr<Exchange> exchange, httplib::Result result, const WireStats& wire = {});
+
+    void runQueued();
+
+    void runTimers();
+
+    void sweepDeadlines();
+
+#ifdef NETZ_IO_URING
+    struct Operation {
+        enum { CONNECT, RECEIVE, SEND, WAKE } kind;
+        int fd = -1;
+        // tells a stale completion apart from one for a new connection that got the same fd
+        uint64_t serial = 0;
+        int buffer = -1;
+        // connect reads the address from here while it is in flight
+        Address address{};
+    };
+
+    // queue op on the ring; its id comes back with the completion
+    uint64_t submit(io_uring_sqe* sqe, Operation op);
+
+    void connectRing(Connection& connection, const Address& address);
+
+    // keep a receive, and a send while the outbox has bytes, in flight on the connection
+    void arm(Connection& connection);
+
+    void armWake();
+
+    void cancel(uint64_t id);
+
+    void onCompletion(uint64_t id, int result);
+
+    std::unique_ptr<IoUring> ring;
+    std::map<uint64_t, Operation> operations;
+    uint64_t next_operation = 1;
+    uint64_t next_serial = 1;
+    uint64_t wake_op = 0;
+    // a connection went without a receive because every buffer was taken
+    bool starved = false;
+#endif
+
+    int epoll_fd = -1;
+    int wake_fd = -1;
+    SSL_CTX* tls_context = nullptr;
+
+    std::map<int, std::unique_ptr<Connection>> connections;
+    std::map<std::string, std::deque<Connection*>> idle;
+    std::map<std::string, size_t> open_connections;
+    std::map<std::string, size_t> connecting;
+    std::map<std::string, std::deque<std::unique_ptr<Exchange>>> waiting;
+
+    std::vector<std::unique_ptr<Exchange>> queued;
+    std::multimap<std::chrono::steady_clock::time_point, std::function<void()>> timers;
+    std::mutex mutex;
+
+    std::atomic<size_t> in_flight{0};
+    std::atomic<bool> stopped{false};
+};
+
+#endif
+
+#endif
@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <vector>
+
+#include "Hedging.hpp"
+
+double Hedging::percentile = 0;
+double Hedging::budget = 0;
+std::map<std::string, std::deque<std::chrono::steady_clock::duration>> Hedging::latencies;
+std::map<std::string, double> Hedging::saved;
+std::mutex Hedging::mutex;
+Hedging::Timers Hedging::timers;
+
+Hedging::Timers::~Timers() {
+    {
+        std::lock_guard<std::mutex> lock(Hedging::mutex);
+        stopped = true;
+    }
+    changed.notify_all();
+    if (thread.joinable()) thread.join();
+}
+
+void Hedging::configure(double percentile, double budget) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Hedging::percentile = percentile;
+    Hedging::budget = budget;
+}
+
+bool Hedging::enabled() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return 0 < percentile;
+}
+
+std::chrono::steady_clock::duration Hedging::delay(const std::string& provider, const std::string& operation) {
+    std::vector<std::chrono::steady_clock::duration> sorted;
+    double rank = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (0 >= percentile) return std::chrono::steady_clock::duration::zero();
+        auto found = latencies.find(provider + ":" + operation);
+        if (found == latencies.end() || found->second.size() < MIN_SAMPLES) return std::chrono::steady_clock::duration::zero();
+        sorted.assign(found->second.begin(), found->second.end());
+        rank = percentile;
+    }
+    auto nth = sorted.begin() + static_cast<long>((sorted.size() - 1) * rank / 100);
+    std::nth_element(sorted.begin(), nth, sorted.end());
+    return *nth;
+}
+
+void Hedging::record(const std::string& provider, const std::string& operation,
+                     std::chrono::steady_clock::duration latency) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (0 >= percentile) return;
+    auto& window = latencies[provider + ":" + operation];
+    window.push_back(latency);
+    if (window.size() > WINDOW) window.pop_front();
+    /* every answered request earns a share of a hedge, so hedges stay a fixed fraction of the traffic */
+    double& credit = saved[provider];
+    credit = std::min(MAX_SAVED, credit + budget);
+}
+
+bool Hedging::spend(const std::string& provider) {
+    std::lock_guard<std::mutex> lock(mutex);
+    double& credit = saved[provider];
+    if (credit < 1) return false;
+    credit -= 1;
+    return true;
+}
+
+void Hedging::refund(const std::string& provider) {
+    std::lock_guard<std::mutex> lock(mutex);
+    double& credit = saved[provider];
+    credit = std::min(MAX_SAVED, credit + 1);
+}
+
+Hedging::Timer Hedging::arm(std::chrono::steady_clock::time_point when, std::function<void()> fire) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Timer timer{when, timers.next_id++};
+    bool earliest = timers.due.empty() || timer < timers.due.begin()->first;
+    timers.due.emplace(timer, std::move(fire));
+    if (!timers.thread.joinable()) timers.thread = std::thread(&Hedging::runTimers);
+    /* nearly every timer is disarmed before it is due, only a new earliest one changes the thread's wait */
+    if (earliest) timers.changed.notify_one();
+    return timer;
+}
+
+void Hedging::disarm(const Timer& timer) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (timers.due.erase(timer)) return;
+    }
+    /* gone from the map means it fired, so wait for that fire to finish */
+    std::lock_guard<std::mutex> firing(timers.firing);
+}
+
+void Hedging::runTimers() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!timers.stopped) {
+        if (timers.due.empty()) {
+            timers.changed.wait(lock);
+            continue;
+        }
+        auto first = timers.due.begin();
+        if (first->first.first > std::chrono::steady_clock::now()) {
+            timers.changed.wait_until(lock, first->first.first);
+            continue;
+        }
+        std::function<void()> fire = std::move(first->second);
+        timers.due.erase(first);
+        /* taken before mutex is let go, so a disarm that finds the timer gone always waits for this fire */
+        std::lock_guard<std::mutex> firing(timers.firing);
+        lock.unlock();
+        fire();
+        lock.lock();
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+#ifndef HEDGING_HPP
+#define HEDGING_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+// when a provider request takes longer than most recent ones of its kind, a duplicate goes out and whichever
+// answers first is used. off unless configured; hedges come out of a budget earned by the requests answered
+class Hedging {
+public:
+    // hedge a request still out after this percentile of its operation's recent latencies, with at most
+    // budget hedges per request a provider answered; a percentile of 0 turns hedging off
+    static void configure(double percentile, double budget);
+
+    static bool enabled();
+
+    // how long to give a request before hedging it, zero while the operation has too few samples
+    static std::chrono::steady_clock::duration delay(const std::string& provider, const std::string& operation);
+
+    // a request of provider's operation was answered after latency
+    static void record(const std::string& provider, const std::string& operation,
+                       std::chrono::steady_clock::duration latency);
+
+    // take one hedge out of provider's budget, false when it is spent
+    static bool spend(const std::string& provider);
+
+    // give back a hedge that was not sent after all
+    static void refund(const std::string& provider);
+
+    // when and which, to disarm a timer with
+    using Timer = std::pair<std::chrono::steady_clock::time_point, uint64_t>;
+
+    // run fire on the one shared hedge thread at when, unless disarmed first. fire must not block,
+    // it holds up every other request's timer
+    static Timer arm(std::chrono::steady_clock::time_point when, std::function<void()> fire);
+
+    // once this returns, the timer's fire has either run to the end or never will
+    static void disarm(const Timer& timer);
+
+    // latencies remembered per operation
+    constexpr static size_t WINDOW = 200;
+    // no hedging on a percentile of fewer samples than this
+    constexpr static size_t MIN_SAMPLES = 20;
+    // hedges a quiet provider may save up for a burst of slow responses
+    constexpr static double MAX_SAVED = 10;
+
+private:
+    // started by the first timer armed
+    struct Timers {
+        std::thread thread;
+        std::condition_variable changed;
+        std::map<Timer, std::function<void()>> due;
+        uint64_t next_id = 0;
+        // held while a fire runs, so disarm can wait one out
+        std::mutex firing;
+        bool stopped = false;
+
+        ~Timers();
+    };
+
+    static void runTimers();
+
+    static double percentile;
+    static double budget;
+    static std::map<std::string, std::deque<std::chrono::steady_clock::duration>> latencies;
+    static std::map<std::string, double> saved;
+    static std::mutex mutex;
+    // declared last so it stops before the state its fires use goes away
+    static Timers timers;
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include "IoUring.hpp"
+
+#ifdef NETZ_IO_URING
+
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+std::unique_ptr<IoUring> IoUring::create(unsigned entries, size_t buffers, size_t bufferSize) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0) return nullptr;
+    std::unique_ptr<IoUring> ring(new IoUring());
+    ring->ring_fd = fd;
+    /* waiting with a timeout in the same syscall as the submission needs the extended argument */
+    if (!(params.features & IORING_FEAT_EXT_ARG)) return nullptr;
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) ring->sq_ring_size = ring->cq_ring_size = std::max(ring->sq_ring_size, ring->cq_ring_size);
+    ring->sq_ring = mmap(nullptr, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                         IORING_OFF_SQ_RING);
+    if (MAP_FAILED == ring->sq_ring) {
+        ring->sq_ring = nullptr;
+        return nullptr;
+    }
+    if (single_mmap) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(nullptr, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                             IORING_OFF_CQ_RING);
+        if (MAP_FAILED == ring->cq_ring) {
+            ring->cq_ring = nullptr;
+            return nullptr;
+        }
+    }
+    ring->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (MAP_FAILED == sqes) return nullptr;
+    ring->sqes = static_cast<io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(ring->sq_ring);
+    ring->sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    ring->sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    ring->sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    ring->sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    ring->sq_entries = params.sq_entries;
+    char* cq = static_cast<char*>(ring->cq_ring);
+    ring->cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    ring->cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    ring->cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    /* registration pins the slab once, it counts against RLIMIT_MEMLOCK */
+    ring->buffer_size = bufferSize;
+    ring->slab.resize(buffers * bufferSize);
+    std::vector<iovec> iovecs(buffers);
+    for (size_t i = 0; i < buffers; ++i) {
+        iovecs[i].iov_base = ring->slab.data() + i * bufferSize;
+        iovecs[i].iov_len = bufferSize;
+        ring->free_buffers.push_back(static_cast<int>(buffers - 1 - i));
+    }
+    if (0 != syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, iovecs.data(), buffers)) return nullptr;
+    return ring;
+}
+
+IoUring::~IoUring() {
+    if (sqes) munmap(sqes, sqes_size);
+    if (cq_ring && cq_ring != sq_ring) munmap(cq_ring, cq_ring_size);
+    if (sq_ring) munmap(sq_ring, sq_ring_size);
+    if (ring_fd >= 0) close(ring_fd);
+}
+
+io_uring_sqe* IoUring::next() {
+    unsigned tail = *sq_tail + queued;
+    if (tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries) {
+        submit(0, std::chrono::milliseconds(0));
+        tail = *sq_tail;
+    }
+    unsigned index = tail & *sq_mask;
+    io_uring_sqe* sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array[index] = index;
+    queued++;
+    return sqe;
+}
+
+void IoUring::submitAndWait(std::chrono::milliseconds timeout) {
+    submit(1, timeout);
+}
+
+void IoUring::submit(unsigned waitFor, std::chrono::milliseconds timeout) {
+    __atomic_store_n(sq_tail, *sq_tail + queued, __ATOMIC_RELEASE);
+    unsigned count = queued;
+    queued = 0;
+    __kernel_timespec ts;
+    ts.tv_sec = timeout.count() / 1000;
+    ts.tv_nsec = (timeout.count() % 1000) * 1000000;
+    io_uring_getevents_arg arg;
+    std::memset(&arg, 0, sizeof(arg));
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+    unsigned flags = IORING_ENTER_EXT_ARG | (waitFor ? IORING_ENTER_GETEVENTS : 0);
+    /* a timeout or signal ending the wait is fine, the caller just looks at what completed */
+    syscall(__NR_io_uring_enter, ring_fd, count, waitFor, flags, &arg, sizeof(arg));
+}
+
+int IoUring::takeBuffer() {
+    if (free_buffers.empty()) return -1;
+    int index = free_buffers.back();
+    free_buffers.pop_back();
+    return index;
+}
+
+void IoUring::releaseBuffer(int index) {
+    free_buffers.push_back(index);
+}
+
+char* IoUring::buffer(int index) {
+    return slab.data() + static_cast<size_t>(index) * buffer_size;
+}
+
+size_t IoUring::bufferSize() const {
+    return buffer_size;
+}
+
+#endif
@@ -0,0 +1,88 @@
+#pragma once
+#ifndef IO_URING_HPP
+#define IO_URING_HPP
+
+// opt in with -DNETZ_IO_URING; needs linux 5.11 or later, and no liburing
+#if defined(NETZ_IO_URING) && defined(__linux__)
+
+#include <chrono>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <memory>
+#include <vector>
+
+// a submission and completion ring driven through the raw syscalls, with a slab of buffers registered with the
+// kernel so reads and writes skip pinning and mapping user memory on every operation
+class IoUring {
+public:
+    // nullptr when the kernel, or a sandbox filtering its syscalls, refuses the ring or the buffers
+    static std::unique_ptr<IoUring> create(unsigned entries, size_t buffers, size_t bufferSize);
+
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // a zeroed entry to fill in; queued entries go to the kernel together on the next submitAndWait,
+    // or right away when the queue is full
+    io_uring_sqe* next();
+
+    // one syscall submitting everything queued and waiting up to timeout for a completion
+    void submitAndWait(std::chrono::milliseconds timeout);
+
+    // hand every completion the kernel has posted to fn(user_data, result)
+    template<typename F>
+    void forEachCompletion(F fn) {
+        unsigned head = *cq_head;
+        while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+            const io_uring_cqe& cqe = cqes[head & *cq_mask];
+            uint64_t user_data = cqe.user_data;
+            int result = cqe.res;
+            /* free the slot before fn runs, it may queue work whose completions need room */
+            __atomic_store_n(cq_head, ++head, __ATOMIC_RELEASE);
+            fn(user_data, result);
+        }
+    }
+
+    // index of a free registered buffer, -1 while all are in use
+    int takeBuffer();
+
+    void releaseBuffer(int index);
+
+    char* buffer(int index);
+
+    size_t bufferSize() const;
+
+private:
+    IoUring() = default;
+
+    void submit(unsigned waitFor, std::chrono::milliseconds timeout);
+
+    int ring_fd = -1;
+    void* sq_ring = nullptr;
+    size_t sq_ring_size = 0;
+    void* cq_ring = nullptr;
+    size_t cq_ring_size = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqes_size = 0;
+
+    unsigned* sq_head = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_mask = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned sq_entries = 0;
+    unsigned queued = 0;
+
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned* cq_mask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+    std::vector<char> slab;
+    size_t buffer_size = 0;
+    std::vector<int> free_buffers;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+#include <thread>
+
+#include "KeyPool.hpp"
+#include "RateLimiter.hpp"
+
+std::map<std::string, KeyPool::Pool> KeyPool::pools;
+std::mutex KeyPool::mutex;
+
+void KeyPool::load() {
+    const std::vector<std::pair<std::string, const char*>> variables = {
+        {"etherscan", "ETHERSCAN_API_KEY"},
+        {"trongrid", "TRON_API_KEY"},
+        {"shyft", "SHYFT_API_KEY"},
+        {"chainalysis", "CHAINALYSIS_API_KEY"},
+    };
+    for (const auto& [provider, variable] : variables) {
+        const char* value = std::getenv(variable);
+        if (!value) continue;
+        std::stringstream keys(value);
+        std::string key;
+        while (std::getline(keys, key, ',')) {
+            key.erase(0, key.find_first_not_of(" \t"));
+            key.erase(key.find_last_not_of(" \t") + 1);
+            if (!key.empty()) add(provider, key);
+        }
+    }
+}
+
+void KeyPool::add(const std::string& provider, const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Pool& pool = pools[provider];
+    for (const Key& existing : pool.keys) {
+        if (existing.value == key) return;
+    }
+    pool.keys.push_back({key, std::chrono::steady_clock::time_point()});
+}
+
+size_t KeyPool::size(const std::string& provider) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = pools.find(provider);
+    return it == pools.end() ? 0 : it->second.keys.size();
+}
+
+bool KeyPool::acquire(const std::string& provider, const std::string& operation, Priority priority, std::string& key) {
+    double waited = 0;
+    while (true) {
+        double wait = tryAcquire(provider, operation, priority, key);
+        if (0 == wait) return true;
+        if (!shouldWait(priority, waited, wait)) return false;
+        std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+        waited += wait;
+    }
+}
+
+double KeyPool::tryAcquire(const std::string& provider, const std::string& operation, Priority priority, std::string& key,
+                           const std::string& avoid) {
+    std::vector<std::string> candidates;
+    double wait = std::numeric_limits<double>::max();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Pool& pool = pools[provider];
+        auto now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < pool.keys.size(); ++i) {
+            const Key& candidate = pool.keys[(pool.next + i) % pool.keys.size()];
+            if (candidate.coolingUntil > now) {
+                wait = std::min(wait, std::chrono::duration<double>(candidate.coolingUntil - now).count());
+                continue;
+            }
+            candidates.push_back(candidate.value);
+        }
+        if (!pool.keys.empty()) pool.next = (pool.next + 1) % pool.keys.size();
+        /* tried last rather than left out, with a single key it is the only one there is */
+        auto avoided = std::find(candidates.begin(), candidates.end(), avoid);
+        if (!avoid.empty() && avoided != candidates.end()) std::rotate(avoided, avoided + 1, candidates.end());
+        /* without any key configured the request still goes out, for the provider to reject */
+        if (pool.keys.empty()) candidates.push_back("");
+    }
+    for (const std::string& candidate : candidates) {
+        double candidate_wait = RateLimiter::tryAcquire(provider, candidate, operation, priority);
+        if (0 == candidate_wait) {
+            key = candidate;
+            return 0;
+        }
+        wait = std::min(wait, candidate_wait);
+    }
+    return wait;
+}
+
+bool KeyPool::shouldWait(Priority priority, double waited, double wait) {
+    if (RateLimiter::DROP == RateLimiter::getPolicy()) return false;
+    return Priority::BACKGROUND != priority || waited + wait <= RateLimiter::BACKGROUND_MAX_WAIT_SECONDS;
+}
+
+void KeyPool::coolDown(const std::string& provider, const std::string& key, std::chrono::seconds duration) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (Key& candidate : pools[provider].keys) {
+        if (candidate.value == key) candidate.coolingUntil = std::chrono::steady_clock::now() + duration;
+    }
+}
+
+std::string KeyPool::withKey(std::string text, const std::string& key) {
+    const std::string placeholder = PLACEHOLDER;
+    for (size_t pos = text.find(placeholder); pos != std::string::npos; pos = text.find(placeholder, pos + key.length())) {
+        text.replace(pos, placeholder.length(), key);
+    }
+    return text;
+}
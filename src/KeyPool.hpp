@@ -0,0 +1,58 @@
+#pragma once
+#ifndef KEY_POOL_HPP
+#define KEY_POOL_HPP
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Priority.hpp"
+
+class KeyPool {
+public:
+    // stands in for the api key in request paths and headers until a key is picked at send time
+    static constexpr const char* PLACEHOLDER = "{api_key}";
+
+    // read every provider's comma separated keys from its environment variable, once at startup
+    static void load();
+
+    static void add(const std::string& provider, const std::string& key);
+
+    static size_t size(const std::string& provider);
+
+    // pick the next key of the provider, round robin, that is not cooling down and has the tokens for the operation;
+    // false when the rate limit policy drops the request, or background work found no spare tokens in time
+    static bool acquire(const std::string& provider, const std::string& operation, Priority priority, std::string& key);
+
+    // acquire without blocking: take the tokens on the next usable key and return 0, or take nothing and
+    // return the seconds until some key could have them. avoid is only picked when no other key can go
+    static double tryAcquire(const std::string& provider, const std::string& operation, Priority priority, std::string& key,
+                             const std::string& avoid = "");
+
+    // whether a request that has waited for waited seconds should wait another wait seconds rather than be dropped
+    static bool shouldWait(Priority priority, double waited, double wait);
+
+    // provider told us the key is over its limit, rest it before handing it out again
+    static void coolDown(const std::string& provider, const std::string& key, std::chrono::seconds duration);
+
+    // every placeholder in text replaced with key
+    static std::string withKey(std::string text, const std::string& key);
+
+private:
+    struct Key {
+        std::string value;
+        std::chrono::steady_clock::time_point coolingUntil;
+    };
+
+    struct Pool {
+        std::vector<Key> keys;
+        size_t next = 0;
+    };
+
+    static std::map<std::string, Pool> pools;
+    static std::mutex mutex;
+};
+
+#endif
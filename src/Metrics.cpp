@@ -0,0 +1,38 @@
+#include <algorithm>
+#include <sstream>
+
+#include "Metrics.hpp"
+#include "OutputSink.hpp"
+
+std::map<std::string, Metrics::Counters> Metrics::counters;
+std::mutex Metrics::mutex;
+
+Metrics::Counters& Metrics::get(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    /* map nodes never move, so the reference stays valid after the lock is released */
+    return counters[name];
+}
+
+void Metrics::report() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& [name, c] : counters) {
+        std::ostringstream text;
+        text << "[metrics] " << name;
+        if (c.polls) text << " polls=" << c.polls << " idle=" << c.idlePolls << " unchanged=" << c.unchangedBodies;
+        if (c.requests) text << " requests=" << c.requests << " failed=" << c.failedRequests
+                             << " bytes=" << c.responseBytes;
+        if (c.wireBytes && c.wireBytes != c.responseBytes) {
+            text << " wire=" << c.wireBytes << " saved=" << 100 - 100 * c.wireBytes / std::max(1LL, c.responseBytes.load())
+                 << "% decode_ms=" << c.decodeMicros / 1000;
+        }
+        if (c.hedges) text << " hedged=" << c.hedges << " hedge_wins=" << c.hedgeWins
+                           << " cancelled=" << c.cancelledRequests;
+        if (c.starvedSteps) text << " starved=" << c.starvedSteps;
+        if (c.droppedRequests) text << " rate_limited=" << c.droppedRequests;
+        if (c.throttledRequests) text << " throttled=" << c.throttledRequests;
+        if (c.newTransactions) text << " new_txs=" << c.newTransactions;
+        if (c.screened) text << " screened=" << c.screened << " cache_hits=" << c.cacheHits
+                             << " sanctioned=" << c.sanctionedHits;
+        OutputSink::line(text.str());
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+
+class Metrics {
+public:
+    struct Counters {
+        std::atomic<long long> polls{0};
+        std::atomic<long long> idlePolls{0};
+        // background steps that found no quota to spend
+        std::atomic<long long> starvedSteps{0};
+        std::atomic<long long> unchangedBodies{0};
+        std::atomic<long long> requests{0};
+        std::atomic<long long> failedRequests{0};
+        std::atomic<long long> droppedRequests{0};
+        std::atomic<long long> throttledRequests{0};
+        std::atomic<long long> responseBytes{0};
+        // response bodies as received, before decoding, and the time spent decoding them
+        std::atomic<long long> wireBytes{0};
+        std::atomic<long long> decodeMicros{0};
+        // duplicates sent for slow requests, and how many of them answered first
+        std::atomic<long long> hedges{0};
+        std::atomic<long long> hedgeWins{0};
+        // requests sent and then cancelled, the losers of a hedge
+        std::atomic<long long> cancelledRequests{0};
+        std::atomic<long long> newTransactions{0};
+        std::atomic<long long> screened{0};
+        std::atomic<long long> cacheHits{0};
+        std::atomic<long long> sanctionedHits{0};
+    };
+
+    // counters for a network or provider, created on first use and shared by every thread
+    static Counters& get(const std::string& name);
+
+    // one line per network and provider seen so far
+    static void report();
+
+private:
+    static std::map<std::string, Counters> counters;
+    static std::mutex mutex;
+};
+
+#endif
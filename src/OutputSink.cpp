@@ -0,0 +1,9 @@
+#include "OutputSink.hpp"
+
+std::mutex OutputSink::mutex;
+
+void OutputSink::write(std::ostream& stream, const std::string& text) {
+    std::lock_guard<std::mutex> lock(mutex);
+    stream << text << "\n";
+    stream.flush();
+}
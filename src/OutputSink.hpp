@@ -0,0 +1,33 @@
+#pragma once
+#ifndef OUTPUT_SINK_HPP
+#define OUTPUT_SINK_HPP
+
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+class OutputSink {
+public:
+    // every thread, target and network writes through here, so lines never interleave
+    template<typename... Args>
+    static void line(const Args&... args) {
+        std::ostringstream text;
+        (text << ... << args);
+        write(std::cout, text.str());
+    }
+
+    template<typename... Args>
+    static void errorLine(const Args&... args) {
+        std::ostringstream text;
+        (text << ... << args);
+        write(std::cerr, text.str());
+    }
+
+private:
+    static void write(std::ostream& stream, const std::string& text);
+
+    static std::mutex mutex;
+};
+
+#endif
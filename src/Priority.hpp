@@ -0,0 +1,44 @@
+#pragma once
+#ifndef PRIORITY_HPP
+#define PRIORITY_HPP
+
+#include <cstddef>
+#include <string_view>
+
+// background and urgent are never configured: background is work that only runs on leftover capacity,
+// and a target is raised to urgent for a while after one of its counterparties turns out sanctioned
+enum class Priority { BACKGROUND, LOW, NORMAL, HIGH, URGENT };
+
+class Priorities {
+public:
+    static constexpr size_t COUNT = 5;
+
+    // the names a watchlist may use: low, normal, high
+    static bool parse(std::string_view text, Priority& priority) {
+        if (text == "low") priority = Priority::LOW;
+        else if (text == "normal") priority = Priority::NORMAL;
+        else if (text == "high") priority = Priority::HIGH;
+        else return false;
+        return true;
+    }
+
+    static constexpr const char* name(Priority priority) {
+        return priority == Priority::BACKGROUND ? "background"
+             : priority == Priority::LOW ? "low"
+             : priority == Priority::NORMAL ? "normal"
+             : priority == Priority::HIGH ? "high"
+             : "urgent";
+    }
+
+    // share of every rate limit bucket a priority may not spend, so when tokens run short
+    // the ones left over go to the priorities above it; background only spends a bucket nobody else is draining
+    static constexpr double reserve(Priority priority) {
+        return priority == Priority::BACKGROUND ? 0.8
+             : priority == Priority::LOW ? 0.5
+             : priority == Priority::NORMAL ? 0.25
+             : priority == Priority::HIGH ? 0.1
+             : 0.0;
+    }
+};
+
+#endif
@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <thread>
+
+#include "RateLimiter.hpp"
+
+TokenBucket::TokenBucket(double ratePerSecond, double burst)
+    : rate(ratePerSecond), burst(burst), tokens(burst), last_refill(std::chrono::steady_clock::now()) {}
+
+void TokenBucket::refill() {
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - last_refill).count();
+    tokens = std::min(burst, tokens + elapsed * rate);
+    last_refill = now;
+}
+
+double TokenBucket::take(double cost, double reserve) {
+    std::lock_guard<std::mutex> lock(mutex);
+    refill();
+    /* the full cost is always charged, so every priority spends at the configured rate. a cost the reserve
+       leaves no room for shrinks the reserve instead, and one beyond the whole bucket goes out once it is
+       full and leaves the bucket in debt */
+    const double need = std::min(cost, burst);
+    const double floor = std::min(burst * reserve, burst - need);
+    if (tokens - floor >= need) {
+        tokens -= cost;
+        return 0;
+    }
+    return (need + floor - tokens) / rate;
+}
+
+void TokenBucket::refund(double cost) {
+    std::lock_guard<std::mutex> lock(mutex);
+    tokens = std::min(burst, tokens + cost);
+}
+
+void TokenBucket::configure(double ratePerSecond, double burst) {
+    std::lock_guard<std::mutex> lock(mutex);
+    refill();
+    this->rate = ratePerSecond;
+    this->burst = burst;
+    tokens = std::min(tokens, burst);
+}
+
+double TokenBucket::available() {
+    std::lock_guard<std::mutex> lock(mutex);
+    refill();
+    return tokens;
+}
+
+/* published free-tier limits per api key */
+std::map<std::string, std::pair<double, double>> RateLimiter::key_rates = {
+    {"etherscan", {5, 5}},
+    {"trongrid", {15, 15}},
+    {"shyft", {10, 10}},
+    {"chainalysis", {16, 16}},
+};
+std::map<std::string, std::unique_ptr<TokenBucket>> RateLimiter::key_buckets;
+std::map<std::string, std::unique_ptr<TokenBucket>> RateLimiter::provider_buckets;
+std::map<std::string, double> RateLimiter::costs;
+RateLimiter::Policy RateLimiter::policy = RateLimiter::WAIT;
+std::mutex RateLimiter::mutex;
+
+void RateLimiter::setKeyRate(const std::string& provider, double ratePerSecond, double burst) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (burst <= 0) burst = std::max(1.0, ratePerSecond);
+    key_rates[provider] = {ratePerSecond, burst};
+    for (auto& [name, bucket] : key_buckets) {
+        if (0 == name.compare(0, provider.length() + 1, provider + "/")) bucket->configure(ratePerSecond, burst);
+    }
+}
+
+void RateLimiter::setProviderRate(const std::string& provider, double ratePerSecond, double burst) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (burst <= 0) burst = std::max(1.0, ratePerSecond);
+    auto& bucket = provider_buckets[provider];
+    if (bucket) bucket->configure(ratePerSecond, burst);
+    else bucket = std::make_unique<TokenBucket>(ratePerSecond, burst);
+}
+
+void RateLimiter::setCost(const std::string& provider, const std::string& operation, double cost) {
+    std::lock_guard<std::mutex> lock(mutex);
+    costs[provider + ":" + operation] = cost;
+}
+
+void RateLimiter::setPolicy(Policy policy) {
+    std::lock_guard<std::mutex> lock(mutex);
+    RateLimiter::policy = policy;
+}
+
+TokenBucket& RateLimiter::keyBucket(const std::string& provider, const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& bucket = key_buckets[provider + "/" + key];
+    if (!bucket) {
+        auto rate = key_rates.find(provider);
+        bucket = rate == key_rates.end()
+            ? std::make_unique<TokenBucket>(5, 5)
+            : std::make_unique<TokenBucket>(rate->second.first, rate->second.second);
+    }
+    /* buckets are never erased, so the reference outlives the lock */
+    return *bucket;
+}
+
+TokenBucket* RateLimiter::providerBucket(const std::string& provider) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = provider_buckets.find(provider);
+    return it == provider_buckets.end() ? nullptr : it->second.get();
+}
+
+double RateLimiter::costOf(const std::string& provider, const std::string& operation) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = costs.find(provider + ":" + operation);
+    return it == costs.end() ? 1 : it->second;
+}
+
+RateLimiter::Policy RateLimiter::getPolicy() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return policy;
+}
+
+double RateLimiter::tryAcquire(const std::string& provider, const std::string& key, const std::string& operation,
+                               Priority priority) {
+    TokenBucket& per_key = keyBucket(provider, key);
+    TokenBucket* per_provider = providerBucket(provider);
+    const double cost = costOf(provider, operation);
+    const double reserve = Priorities::reserve(priority);
+    double wait = per_key.take(cost, reserve);
+    if (0 == wait && per_provider) {
+        wait = per_provider->take(cost, reserve);
+        /* both buckets or neither, so a blocked provider cap doesn't leak the key's tokens */
+        if (0 != wait) per_key.refund(cost);
+    }
+    return wait;
+}
+
+bool RateLimiter::acquire(const std::string& provider, const std::string& key, const std::string& operation,
+                          Priority priority) {
+    double waited = 0;
+    while (true) {
+        double wait = tryAcquire(provider, key, operation, priority);
+        if (0 == wait) return true;
+        if (DROP == getPolicy()) return false;
+        if (Priority::BACKGROUND == priority && waited + wait > BACKGROUND_MAX_WAIT_SECONDS) return false;
+        std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+        waited += wait;
+    }
+}
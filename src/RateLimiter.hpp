@@ -0,0 +1,82 @@
+#pragma once
+#ifndef RATE_LIMITER_HPP
+#define RATE_LIMITER_HPP
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "Priority.hpp"
+
+class TokenBucket {
+public:
+    TokenBucket(double ratePerSecond, double burst);
+
+    // take cost tokens and return 0, or leave the bucket alone and return the seconds until they would be there;
+    // the reserve share of the bucket is off limits to this caller
+    double take(double cost, double reserve = 0);
+
+    // give back the cost take charged for a request that was not sent after all
+    void refund(double cost);
+
+    void configure(double ratePerSecond, double burst);
+
+    double available();
+
+private:
+    void refill();
+
+    double rate;
+    double burst;
+    double tokens;
+    std::chrono::steady_clock::time_point last_refill;
+    std::mutex mutex;
+};
+
+class RateLimiter {
+public:
+    enum Policy { WAIT, DROP };
+
+    // rate every api key of a provider may use, as published by the provider
+    static void setKeyRate(const std::string& provider, double ratePerSecond, double burst = 0);
+
+    // optional cap across all keys of a provider, e.g. a per-ip limit; unlimited unless set
+    static void setProviderRate(const std::string& provider, double ratePerSecond, double burst = 0);
+
+    // tokens one call of an operation spends, 1 unless set
+    static void setCost(const std::string& provider, const std::string& operation, double cost);
+
+    static void setPolicy(Policy policy);
+
+    // longest a background request waits for tokens above its reserve before giving up its worker
+    static constexpr double BACKGROUND_MAX_WAIT_SECONDS = 1.0;
+
+    // block until the request may go out, or under DROP return false straight away;
+    // background requests only wait up to BACKGROUND_MAX_WAIT_SECONDS
+    static bool acquire(const std::string& provider, const std::string& key, const std::string& operation,
+                        Priority priority = Priority::NORMAL);
+
+    // take the request's tokens and return 0, or take nothing and return the seconds until they would be there
+    static double tryAcquire(const std::string& provider, const std::string& key, const std::string& operation,
+                             Priority priority = Priority::NORMAL);
+
+    static Policy getPolicy();
+
+private:
+    static TokenBucket& keyBucket(const std::string& provider, const std::string& key);
+
+    static TokenBucket* providerBucket(const std::string& provider);
+
+    static double costOf(const std::string& provider, const std::string& operation);
+
+    static std::map<std::string, std::pair<double, double>> key_rates;
+    static std::map<std::string, std::unique_ptr<TokenBucket>> key_buckets;
+    static std::map<std::string, std::unique_ptr<TokenBucket>> provider_buckets;
+    static std::map<std::string, double> costs;
+    static Policy policy;
+    static std::mutex mutex;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <netdb.h>
+#include <sys/socket.h>
+
+#include "Resolver.hpp"
+
+std::map<std::string, Resolver::Entry> Resolver::entries;
+std::mutex Resolver::mutex;
+Resolver::Refresher Resolver::refresher;
+
+Resolver::Refresher::~Refresher() {
+    {
+        std::lock_guard<std::mutex> lock(Resolver::mutex);
+        stopped = true;
+    }
+    wake.notify_all();
+    if (thread.joinable()) thread.join();
+}
+
+std::vector<std::string> Resolver::lookup(const std::string& name) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = entries.find(name);
+        if (found != entries.end()) {
+            Entry& entry = found->second;
+            auto now = std::chrono::steady_clock::now();
+            if (!entry.addresses.empty()) {
+                if (now >= entry.expires) queueRefresh(name, entry);
+                return entry.addresses;
+            }
+            /* don't hammer a resolver that just failed on this name */
+            if (now < entry.expires && !entry.refreshing) return {};
+        }
+    }
+    /* nothing to serve yet, so this once the caller waits; a warm-up still under way resolves it twice */
+    std::vector<std::string> addresses = resolve(name);
+    store(name, addresses);
+    return addresses;
+}
+
+void Resolver::demote(const std::string& name, const std::string& address) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = entries.find(name);
+    if (found == entries.end()) return;
+    std::vector<std::string>& addresses = found->second.addresses;
+    /* moved to the back rather than dropped, it may only be down for a moment and could be all there is */
+    auto failed = std::find(addresses.begin(), addresses.end(), address);
+    if (failed != addresses.end()) std::rotate(failed, failed + 1, addresses.end());
+}
+
+void Resolver::warm(const std::vector<std::string>& hosts) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const std::string& host : hosts) {
+        std::string name = hostName(host);
+        if (!name.empty()) queueRefresh(name, entries[name]);
+    }
+}
+
+std::string Resolver::hostName(const std::string& host) {
+    size_t scheme_end = host.find("://");
+    std::string authority = scheme_end == std::string::npos ? host : host.substr(scheme_end + 3);
+    authority = authority.substr(0, authority.find('/'));
+    if (!authority.empty() && '[' == authority.front()) {
+        size_t close = authority.find(']');
+        return close == std::string::npos ? "" : authority.substr(1, close - 1);
+    }
+    return authority.substr(0, authority.find(':'));
+}
+
+std::vector<std::string> Resolver::resolve(const std::string& name) {
+    std::vector<std::string> addresses;
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if (0 != getaddrinfo(name.c_str(), nullptr, &hints, &result) || !result) return addresses;
+    /* kept in the resolver's order, which already puts the preferred family first */
+    for (addrinfo* entry = result; entry; entry = entry->ai_next) {
+        char address[NI_MAXHOST] = {};
+        if (0 != getnameinfo(entry->ai_addr, entry->ai_addrlen, address, sizeof(address), nullptr, 0, NI_NUMERICHOST)) continue;
+        if (std::find(addresses.begin(), addresses.end(), address) == addresses.end()) addresses.push_back(address);
+    }
+    freeaddrinfo(result);
+    return addresses;
+}
+
+void Resolver::queueRefresh(const std::string& name, Entry& entry) {
+    if (entry.refreshing) return;
+    entry.refreshing = true;
+    refresher.names.push_back(name);
+    if (!refresher.thread.joinable()) refresher.thread = std::thread(&Resolver::runRefresher);
+    refresher.wake.notify_one();
+}
+
+void Resolver::store(const std::string& name, const std::vector<std::string>& addresses) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry& entry = entries[name];
+    entry.refreshing = false;
+    /* a failed lookup keeps the last good addresses and tries again sooner */
+    if (addresses.empty()) {
+        entry.expires = std::chrono::steady_clock::now() + RETRY_AFTER;
+        return;
+    }
+    entry.addresses = addresses;
+    entry.expires = std::chrono::steady_clock::now() + TTL;
+}
+
+void Resolver::runRefresher() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        refresher.wake.wait(lock, []() { return refresher.stopped || !refresher.names.empty(); });
+        if (refresher.stopped) return;
+        std::string name = std::move(refresher.names.front());
+        refresher.names.pop_front();
+        lock.unlock();
+        std::vector<std::string> addresses = resolve(name);
+        store(name, addresses);
+        lock.lock();
+    }
+}
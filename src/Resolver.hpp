@@ -0,0 +1,70 @@
+#pragma once
+#ifndef RESOLVER_HPP
+#define RESOLVER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// process-wide cache of provider host names to addresses, so opening a connection doesn't wait on the resolver.
+// addresses past their TTL keep being served while a background thread resolves the name again, and a name
+// that stops resolving keeps its last good addresses
+class Resolver {
+public:
+    // numeric addresses of name, in the order to try them, none when it has not resolved yet.
+    // only a name's first lookup blocks
+    static std::vector<std::string> lookup(const std::string& name);
+
+    // a connect to address failed, so later connections to name try it last
+    static void demote(const std::string& name, const std::string& address);
+
+    // resolve the names of hosts in the background, ahead of the first requests to them
+    static void warm(const std::vector<std::string>& hosts);
+
+    // the name in a host as in ApiClient::URLs, scheme://name[:port]
+    static std::string hostName(const std::string& host);
+
+    // getaddrinfo doesn't report the record's ttl, so every name gets this one
+    constexpr static std::chrono::seconds TTL{60};
+    // how soon a name that failed to resolve is tried again
+    constexpr static std::chrono::seconds RETRY_AFTER{5};
+
+private:
+    struct Entry {
+        std::vector<std::string> addresses;
+        std::chrono::steady_clock::time_point expires;
+        bool refreshing = false;
+    };
+
+    // resolves stale names off the request path, started by the first one
+    struct Refresher {
+        std::thread thread;
+        std::condition_variable wake;
+        std::deque<std::string> names;
+        bool stopped = false;
+
+        ~Refresher();
+    };
+
+    // every address name resolves to, none when it doesn't
+    static std::vector<std::string> resolve(const std::string& name);
+
+    // queue name for the refresher, with mutex held
+    static void queueRefresh(const std::string& name, Entry& entry);
+
+    static void store(const std::string& name, const std::vector<std::string>& addresses);
+
+    static void runRefresher();
+
+    static std::map<std::string, Entry> entries;
+    static std::mutex mutex;
+    // declared last so it stops before the entries it writes go away
+    static Refresher refresher;
+};
+
+#endif
@@ -0,0 +1,77 @@
+#include <algorithm>
+
+#include "Scheduler.hpp"
+
+Scheduler::Scheduler(std::shared_ptr<WorkQueue> queue, std::function<bool(size_t)> poll,
+                     std::function<Priority(size_t)> priorityOf, const Backoff& backoff)
+    : queue(queue), poll(poll), priorityOf(priorityOf), backoff(backoff), jitter_source(std::random_device{}()) {
+    this->backoff.initial = std::clamp(backoff.initial, backoff.min, backoff.max);
+}
+
+void Scheduler::addTargets(size_t count) {
+    auto now = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t first = intervals.size();
+    intervals.resize(first + count, backoff.initial);
+    for (size_t i = 0; i < count; ++i) priorities.push_back(priorityOf(first + i));
+    tenants.resize(first + count, 0);
+    for (size_t i = 0; i < count; ++i) {
+        heap.push({now + backoff.initial * static_cast<long long>(i) / static_cast<long long>(count), first + i});
+    }
+    changed.notify_one();
+}
+
+void Scheduler::setTenant(size_t target, size_t tenant) {
+    std::lock_guard<std::mutex> lock(mutex);
+    tenants[target] = tenant;
+}
+
+void Scheduler::schedule(size_t target, Clock::time_point due) {
+    std::lock_guard<std::mutex> lock(mutex);
+    heap.push({due, target});
+    changed.notify_one();
+}
+
+void Scheduler::reschedule(size_t target, bool active) {
+    Priority priority = priorityOf(target);
+    std::lock_guard<std::mutex> lock(mutex);
+    priorities[target] = priority;
+    std::chrono::milliseconds& interval = intervals[target];
+    interval = active ? backoff.min : std::min(backoff.max, interval * 2);
+    std::uniform_real_distribution<double> spread(1.0 - backoff.jitter, 1.0 + backoff.jitter);
+    /* jitter first and clamp after, so a jittered delay never polls faster than min or slower than max */
+    auto delay = std::clamp(std::chrono::milliseconds(static_cast<long long>(interval.count() * spread(jitter_source))),
+                            backoff.min, backoff.max);
+    heap.push({Clock::now() + delay, target});
+    changed.notify_one();
+}
+
+void Scheduler::run(const std::atomic<bool>& active) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (active.load()) {
+        auto now = Clock::now();
+        while (!heap.empty() && heap.top().due <= now) {
+            size_t target = heap.top().target;
+            heap.pop();
+            queue->push([this, target]() {
+                bool activity = false;
+                try {
+                    activity = poll(target);
+                } catch (...) {
+                    reschedule(target, false);
+                    throw;
+                }
+                reschedule(target, activity);
+            }, priorities[target], tenants[target]);
+        }
+        /* wake for the next due target, a newly scheduled one, or to notice shutdown */
+        auto wake = now + std::chrono::milliseconds(100);
+        if (!heap.empty() && heap.top().due < wake) wake = heap.top().due;
+        changed.wait_until(lock, wake);
+    }
+}
+
+size_t Scheduler::pending() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return heap.size();
+}
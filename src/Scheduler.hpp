@@ -0,0 +1,74 @@
+#pragma once
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include "Priority.hpp"
+#include "WorkQueue.hpp"
+
+class Scheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // how a target's poll interval adapts: back to min after activity, doubling up to max while idle,
+    // every due time moved by up to +-jitter of the interval so targets don't poll in lockstep, though never
+    // outside min and max
+    struct Backoff {
+        std::chrono::milliseconds initial;
+        std::chrono::milliseconds min;
+        std::chrono::milliseconds max;
+        double jitter;
+    };
+
+    // poll runs one target's cycle on a worker and returns whether it saw activity,
+    // the target is only due again once it returns. priorityOf is asked on the same worker right
+    // after each poll, and targets due together reach the workers highest priority first
+    Scheduler(std::shared_ptr<WorkQueue> queue, std::function<bool(size_t)> poll,
+              std::function<Priority(size_t)> priorityOf, const Backoff& backoff);
+
+    // the tenant each target's polls are queued under, 0 unless set
+    void setTenant(size_t target, size_t tenant);
+
+    // spread the first polls of count targets evenly over the initial interval
+    void addTargets(size_t count);
+
+    void schedule(size_t target, Clock::time_point due);
+
+    // hand due targets to the work queue until active goes false
+    void run(const std::atomic<bool>& active);
+
+    size_t pending();
+
+private:
+    struct Entry {
+        Clock::time_point due;
+        size_t target;
+        bool operator>(const Entry& other) const { return due > other.due; }
+    };
+
+    // adapt the target's interval to the poll it just finished and queue its next one
+    void reschedule(size_t target, bool active);
+
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+    std::shared_ptr<WorkQueue> queue;
+    std::function<bool(size_t)> poll;
+    std::function<Priority(size_t)> priorityOf;
+    Backoff backoff;
+    std::vector<std::chrono::milliseconds> intervals;
+    std::vector<Priority> priorities;
+    std::vector<size_t> tenants;
+    std::mt19937 jitter_source;
+    std::mutex mutex;
+    std::condition_variable changed;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#pragma once
+#ifndef SINGLE_FLIGHT_HPP
+#define SINGLE_FLIGHT_HPP
+
+#include <functional>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+
+template<typename K, typename V>
+class SingleFlight {
+public:
+    // run fn for key, or wait for and share the result of the call already in flight for it
+    V run(const K& key, const std::function<V()>& fn) {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto it = in_flight.find(key);
+        if (it != in_flight.end()) {
+            std::shared_future<V> pending = it->second;
+            lock.unlock();
+            return pending.get();
+        }
+        std::promise<V> promise;
+        std::shared_future<V> pending = promise.get_future().share();
+        in_flight[key] = pending;
+        lock.unlock();
+
+        try {
+            promise.set_value(fn());
+        } catch (...) {
+            promise.set_exception(std::current_exception());
+        }
+
+        lock.lock();
+        in_flight.erase(key);
+        lock.unlock();
+        return pending.get();
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return in_flight.size();
+    }
+
+private:
+    std::unordered_map<K, std::shared_future<V>> in_flight;
+    std::mutex mutex;
+};
+
+#endif
@@ -1,14 +1,18 @@
+#include <algorithm>
 #include <iostream>
 #include <thread>
 #include <vector>
 
+#include "BackfillCheckpoint.hpp"
+#include "Metrics.hpp"
+#include "OutputSink.hpp"
+#include "Scheduler.hpp"
 #include "ThreadManager.hpp"
 
 std::atomic<bool> ThreadManager::isProgramActive{true};
-std::mutex ThreadManager::consoleMutex;
 
 template<ApiClient::USE u>
-void ThreadManager::sendRequest(ApiClient& client, bool verbose, MillisecondClock& clock) {
+std::string ThreadManager::sendRequest(ApiClient& client, bool verbose, MillisecondClock& clock) {
     try {
         std::string res;
         if constexpr (u == ApiClient::USE::FETCH_TRANSACTIONS_ETH || u == ApiClient::USE::FETCH_SANCTIONS)
@@ -17,71 +21,324 @@ void ThreadManager::sendRequest(ApiClient& client, bool verbose, MillisecondCloc
             res = client.sendPOSTRequest<u>();
 
         if (verbose) {
-            std::lock_guard<std::mutex> lock(consoleMutex);
-            std::cout << "[" << clock.elapsedMilliseconds() << "ms] "
-                      << "Request completed: " << res << "\n";
+            OutputSink::line("[", clock.elapsedMilliseconds(), "ms] ", "Request completed: ", res);
         }
 
          if constexpr (u == ApiClient::USE::FETCH_SANCTIONS) {
              if (std::string::npos == res.find("Error")) {
-                 std::lock_guard<std::mutex> lock(consoleMutex);
-                 std::cout << "Sanctions check completed.\n";
+                 OutputSink::line("Sanctions check completed.");
              }
          }
+        return res;
     } catch (const std::exception& e) {
-        std::lock_guard<std::mutex> lock(consoleMutex);
-        std::cerr << "Error in request: " << e.what() << "\n";
+        OutputSink::errorLine("Error in request: ", e.what());
+        return "Error: " + std::string(e.what());
     }
 }
 
-void ThreadManager::runWorkerThread(const std::string& target, const std::string& network, bool verbose) {
-    ApiClient client(target);
-    MillisecondClock clock;
-    clock.start();
+template<ApiClient::USE u>
+bool ThreadManager::pollTarget(ApiClient& client, bool verbose, MillisecondClock& clock) {
+    Metrics::Counters& metrics = Metrics::get(ApiClient::networkOf(u));
+    metrics.polls++;
+    if (!client.hasNewActivity<u>()) {
+        metrics.idlePolls++;
+        if (verbose) {
+            OutputSink::line("[", clock.elapsedMilliseconds(), "ms] ", "No new activity, skipping fetch");
+        }
+        return false;
+    }
+    /* tron's getaccount is both the probe and the fetch, so there is nothing heavier to send */
+    if constexpr (u != ApiClient::USE::FETCH_TRANSACTIONS_TRON) {
+        std::string res = sendRequest<u>(client, verbose, clock);
+        /* a byte-identical body has nothing new to extract or screen */
+        if (res == std::to_string(ApiClient::NOT_MODIFIED)) {
+            metrics.unchangedBodies++;
+            return false;
+        }
+        if (res != std::to_string(ApiClient::OK)) {
+            client.resetActivityProbe();
+            /* a failed fetch backs off like an idle poll rather than hammering the provider */
+            return false;
+        }
+    }
+    sendRequest<ApiClient::USE::FETCH_SANCTIONS>(client, verbose, clock);
+    return true;
+}
 
-    while (isProgramActive.load()) {
+bool ThreadManager::pollNetwork(ApiClient& client, const std::string& network, bool verbose, MillisecondClock& clock) {
+    /* for now, sanctions fetch will only work with eth */
+    if (network == "ethereum") {
+        return pollTarget<ApiClient::USE::FETCH_TRANSACTIONS_ETH>(client, verbose, clock);
+    } else if (network == "tron") {
+        return pollTarget<ApiClient::USE::FETCH_TRANSACTIONS_TRON>(client, verbose, clock);
+    } else if (network == "solana") {
+        return pollTarget<ApiClient::USE::FETCH_TRANSACTIONS_SOL>(client, verbose, clock);
+    }
+    return false;
+}
+
+void ThreadManager::runWorkerThread(WorkQueue& queue) {
+    WorkQueue::Task task;
+    while (queue.pop(task)) {
         try {
-            /* for now, sanctions fetch will only work with eth */
-            if (network == "ethereum") {
-                sendRequest<ApiClient::USE::FETCH_TRANSACTIONS_ETH>(client, verbose, clock);
-                sendRequest<ApiClient::USE::FETCH_SANCTIONS>(client, verbose, clock);
-            } else if (network == "tron") {
-                sendRequest<ApiClient::USE::FETCH_TRANSACTIONS_TRON>(client, verbose, clock);
-                sendRequest<ApiClient::USE::FETCH_SANCTIONS>(client, verbose, clock);
-            } else if (network == "solana") {
-                sendRequest<ApiClient::USE::FETCH_TRANSACTIONS_SOL>(client, verbose, clock);
-                sendRequest<ApiClient::USE::FETCH_SANCTIONS>(client, verbose, clock);
-            }
-            std::this_thread::sleep_for(std::chrono::milliseconds(10000));
+            task();
         } catch (const std::exception& e) {
-            std::lock_guard<std::mutex> lock(consoleMutex);
-            std::cerr << "Worker thread error: " << e.what() << std::endl;
-            std::this_thread::sleep_for(std::chrono::milliseconds(5000));
+            OutputSink::errorLine("Worker thread error: ", e.what());
         }
     }
 }
 
-void ThreadManager::startMonitoring(const std::string& target, const std::string& network,
-                                    int numThreads, bool verbose) {
+void ThreadManager::startMonitoring(const std::vector<WatchTarget>& targets, int numThreads, bool verbose,
+                                    int minIntervalMs, int maxIntervalMs,
+                                    const std::map<std::string, double>& tenantWeights, bool backgroundBackfill) {
+    auto queue = std::make_shared<WorkQueue>();
+    MillisecondClock clock;
+    clock.start();
+
+    std::map<std::string, size_t> tenant_ids;
+    std::vector<size_t> target_tenants;
+    for (const WatchTarget& target : targets) {
+        auto id = tenant_ids.emplace(target.tenant, tenant_ids.size()).first->second;
+        target_tenants.push_back(id);
+    }
+    for (const auto& [tenant, id] : tenant_ids) {
+        auto weight = tenantWeights.find(tenant);
+        if (weight != tenantWeights.end()) queue->setTenantWeight(id, weight->second);
+    }
+
+    /* clients are created on a target's first poll and only ever touched by its one in-flight poll */
+    std::vector<std::unique_ptr<ApiClient>> clients(targets.size());
+    Scheduler scheduler(queue, [&](size_t i) {
+        if (!clients[i]) {
+            clients[i] = std::make_unique<ApiClient>(targets[i].address);
+            clients[i]->setWorkQueue(queue);
+            clients[i]->setPriority(targets[i].priority);
+            clients[i]->setTenant(target_tenants[i]);
+        }
+        bool active = pollNetwork(*clients[i], targets[i].network, verbose, clock);
+        Metrics::Counters& tenant_metrics = Metrics::get("tenant " + targets[i].tenant);
+        tenant_metrics.polls++;
+        if (!active) tenant_metrics.idlePolls++;
+        return active;
+    }, [&](size_t i) {
+        return clients[i] ? clients[i]->getPriority() : targets[i].priority;
+    }, Scheduler::Backoff{std::chrono::milliseconds(POLL_INTERVAL_MS), std::chrono::milliseconds(minIntervalMs),
+                          std::chrono::milliseconds(maxIntervalMs), POLL_JITTER});
+    scheduler.addTargets(targets.size());
+    for (size_t i = 0; i < targets.size(); ++i) scheduler.setTenant(i, target_tenants[i]);
+
     std::vector<std::thread> workers;
-    std::cout << "Job began with " << numThreads << " threads...\n";
+    std::cout << "Job began with " << numThreads << " threads for " << targets.size() << " targets";
+    if (tenant_ids.size() > 1) std::cout << " of " << tenant_ids.size() << " tenants";
+    std::cout << "...\n";
     for (int i = 0; i < numThreads; ++i) {
-        workers.emplace_back([=]() {
-            runWorkerThread(target, network, verbose);
+        workers.emplace_back([queue]() {
+            runWorkerThread(*queue);
         });
     }
+    std::thread dispatcher([&]() {
+        scheduler.run(isProgramActive);
+    });
+    BackgroundLane background(queue);
+    background.addJob("verdict refresh", verdictRefreshJob(queue));
+    background.addJob("prefetch", prefetchJob());
+    if (backgroundBackfill) background.addJob("backfill", backfillJob(targets, queue, verbose, clock));
+    std::thread background_feeder([&]() {
+        background.run(isProgramActive);
+    });
+    std::thread reporter([]() {
+        auto next_report = std::chrono::steady_clock::now() + std::chrono::milliseconds(METRICS_INTERVAL_MS);
+        while (isProgramActive.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            if (std::chrono::steady_clock::now() < next_report) continue;
+            Metrics::report();
+            next_report += std::chrono::milliseconds(METRICS_INTERVAL_MS);
+        }
+    });
+
     std::cout << "Press Enter to stop monitoring...\n";
     std::cin.get();
     isProgramActive.store(false);
+    dispatcher.join();
+    background_feeder.join();
+    reporter.join();
+    queue->shutdown();
     for (auto& worker : workers) {
         if (worker.joinable()) {
             worker.join();
         }
     }
+    Metrics::report();
     std::cout << "Monitoring stopped.\n";
 }
 
-template void ThreadManager::sendRequest<ApiClient::USE::FETCH_TRANSACTIONS_ETH>(ApiClient&, bool, MillisecondClock&);
-template void ThreadManager::sendRequest<ApiClient::USE::FETCH_TRANSACTIONS_TRON>(ApiClient&, bool, MillisecondClock&);
-template void ThreadManager::sendRequest<ApiClient::USE::FETCH_TRANSACTIONS_SOL>(ApiClient&, bool, MillisecondClock&);
-template void ThreadManager::sendRequest<ApiClient::USE::FETCH_SANCTIONS>(ApiClient&, bool, MillisecondClock&);
\ No newline at end of file
+bool ThreadManager::backfillRange(ApiClient& client, long long startBlock, long long endBlock,
+                                  bool verbose, MillisecondClock& clock) {
+    if (!isProgramActive.load()) return false;
+    std::string res = client.fetchTransactionRange(startBlock, endBlock);
+    /* dense ranges overflow etherscan's result window, so halve them until each half fits */
+    if (res == std::to_string(ApiClient::TOO_LARGE) && startBlock < endBlock) {
+        long long mid = startBlock + (endBlock - startBlock) / 2;
+        return backfillRange(client, startBlock, mid, verbose, clock)
+            && backfillRange(client, mid + 1, endBlock, verbose, clock);
+    }
+    if (res != std::to_string(ApiClient::OK)) {
+        OutputSink::errorLine("Backfill of blocks ", startBlock, "-", endBlock, " failed: ", res);
+        return false;
+    }
+    /* a chunk whose counterparties weren't all screened is left for a later run rather than checkpointed */
+    res = sendRequest<ApiClient::USE::FETCH_SANCTIONS>(client, verbose, clock);
+    if (std::string::npos != res.find("Error")) {
+        OutputSink::errorLine("Screening of blocks ", startBlock, "-", endBlock, " failed: ", res);
+        return false;
+    }
+    return true;
+}
+
+BackgroundLane::Job ThreadManager::verdictRefreshJob(std::shared_ptr<WorkQueue> queue) {
+    auto client = std::make_shared<ApiClient>("");
+    client->setWorkQueue(queue);
+    client->setPriority(Priority::BACKGROUND);
+    auto expiring = std::make_shared<std::vector<std::string>>();
+    return [client, expiring]() {
+        if (expiring->empty()) *expiring = ApiClient::expiringVerdicts(VERDICT_REFRESH_BATCH);
+        if (expiring->empty()) return BackgroundLane::IDLE;
+        std::string res = client->refreshVerdict(expiring->back());
+        if (ApiClient::isRefused(res)) return BackgroundLane::STARVED;
+        /* any other failure would stall every address behind this one, the next scan finds it again */
+        expiring->pop_back();
+        return BackgroundLane::MORE;
+    };
+}
+
+BackgroundLane::Job ThreadManager::prefetchJob() {
+    return []() {
+        std::string address;
+        size_t refusals = 0;
+        if (!ApiClient::nextPrefetch(address, refusals)) return BackgroundLane::IDLE;
+        ApiClient client(address);
+        client.setPriority(Priority::BACKGROUND);
+        std::string res = client.prefetchSecondHops();
+        /* only a lack of tokens is worth waiting out; a hop the provider won't answer for would otherwise sit at
+           the head of the queue and refetch its transactions every step */
+        if (ApiClient::isRefused(res)) {
+            ApiClient::deferPrefetch(address, refusals + 1);
+            return BackgroundLane::STARVED;
+        }
+        /* any other failure drops the hop, the provider's metrics already count the request that failed */
+        return BackgroundLane::MORE;
+    };
+}
+
+BackgroundLane::Job ThreadManager::backfillJob(const std::vector<WatchTarget>& targets, std::shared_ptr<WorkQueue> queue,
+                                               bool verbose, MillisecondClock& clock) {
+    struct State {
+        size_t target = 0;
+        std::unique_ptr<ApiClient> client;
+        std::unique_ptr<BackfillCheckpoint> checkpoint;
+        long long first_block = 0;
+        long long last_block = 0;
+        size_t chunk_count = 0;
+    };
+    auto state = std::make_shared<State>();
+    return [&targets, queue, verbose, &clock, state]() {
+        while (!state->client) {
+            if (state->target >= targets.size()) return BackgroundLane::IDLE;
+            const WatchTarget& target = targets[state->target];
+            if (target.network != "ethereum") {
+                state->target++;
+                continue;
+            }
+            auto client = std::make_unique<ApiClient>(target.address);
+            client->setWorkQueue(queue);
+            client->setPriority(Priority::BACKGROUND);
+            auto checkpoint = std::make_unique<BackfillCheckpoint>(target.address, BACKFILL_CHUNK_BLOCKS);
+            if (!checkpoint->load(state->first_block, state->last_block)) {
+                std::string res = client->fetchHistoryBounds(state->first_block, state->last_block);
+                if (res == std::to_string(ApiClient::NOT_FOUND)) {
+                    state->target++;
+                    continue;
+                }
+                if (res != std::to_string(ApiClient::OK)) return BackgroundLane::STARVED;
+                checkpoint->begin(state->first_block, state->last_block);
+            }
+            state->chunk_count = static_cast<size_t>((state->last_block - state->first_block) / BACKFILL_CHUNK_BLOCKS + 1);
+            state->client = std::move(client);
+            state->checkpoint = std::move(checkpoint);
+        }
+        size_t chunk = 0;
+        while (chunk < state->chunk_count && state->checkpoint->isDone(chunk)) ++chunk;
+        if (chunk == state->chunk_count) {
+            state->checkpoint->finish();
+            OutputSink::line("Background backfill of ", targets[state->target].address, " complete");
+            state->client.reset();
+            state->checkpoint.reset();
+            state->target++;
+            return BackgroundLane::MORE;
+        }
+        long long start = state->first_block + static_cast<long long>(chunk) * BACKFILL_CHUNK_BLOCKS;
+        long long end = std::min(start + BACKFILL_CHUNK_BLOCKS - 1, state->last_block);
+        if (!backfillRange(*state->client, start, end, verbose, clock)) return BackgroundLane::STARVED;
+        state->checkpoint->markDone(chunk);
+        return BackgroundLane::MORE;
+    };
+}
+
+void ThreadManager::startBackfill(const std::string& target, int numThreads, bool verbose) {
+    BackfillCheckpoint checkpoint(target, BACKFILL_CHUNK_BLOCKS);
+    long long first_block = 0;
+    long long last_block = 0;
+    if (checkpoint.load(first_block, last_block)) {
+        std::cout << "Resuming backfill from " << checkpoint.getPath() << " ("
+                  << checkpoint.doneCount() << " chunks already screened)\n";
+    } else {
+        ApiClient client(target);
+        if (client.fetchHistoryBounds(first_block, last_block) != std::to_string(ApiClient::OK)) return;
+        checkpoint.begin(first_block, last_block);
+    }
+
+    const size_t chunk_count = static_cast<size_t>((last_block - first_block) / BACKFILL_CHUNK_BLOCKS + 1);
+    std::atomic<size_t> next_chunk{0};
+    std::cout << "Backfilling blocks " << first_block << "-" << last_block << " in " << chunk_count
+              << " chunks with " << numThreads << " threads...\n";
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < numThreads; ++i) {
+        workers.emplace_back([&]() {
+            ApiClient client(target);
+            MillisecondClock clock;
+            clock.start();
+            size_t chunk;
+            while (isProgramActive.load() && (chunk = next_chunk++) < chunk_count) {
+                if (checkpoint.isDone(chunk)) continue;
+                long long start = first_block + static_cast<long long>(chunk) * BACKFILL_CHUNK_BLOCKS;
+                long long end = std::min(start + BACKFILL_CHUNK_BLOCKS - 1, last_block);
+                if (backfillRange(client, start, end, verbose, clock)) {
+                    checkpoint.markDone(chunk);
+                    OutputSink::line("Backfill chunk ", chunk + 1, "/", chunk_count, " screened (blocks ", start, "-", end, ")");
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    if (checkpoint.doneCount() == chunk_count) {
+        checkpoint.finish();
+        std::cout << "Backfill complete.\n";
+    } else {
+        std::cout << "Backfill stopped with " << checkpoint.doneCount() << "/" << chunk_count
+                  << " chunks screened. Run --backfill again to resume.\n";
+    }
+}
+
+template std::string ThreadManager::sendRequest<ApiClient::USE::FETCH_TRANSACTIONS_ETH>(ApiClient&, bool, MillisecondClock&);
+template std::string ThreadManager::sendRequest<ApiClient::USE::FETCH_TRANSACTIONS_TRON>(ApiClient&, bool, MillisecondClock&);
+template std::string ThreadManager::sendRequest<ApiClient::USE::FETCH_TRANSACTIONS_SOL>(ApiClient&, bool, MillisecondClock&);
+template std::string ThreadManager::sendRequest<ApiClient::USE::FETCH_SANCTIONS>(ApiClient&, bool, MillisecondClock&);
+template bool ThreadManager::pollTarget<ApiClient::USE::FETCH_TRANSACTIONS_ETH>(ApiClient&, bool, MillisecondClock&);
+template bool ThreadManager::pollTarget<ApiClient::USE::FETCH_TRANSACTIONS_TRON>(ApiClient&, bool, MillisecondClock&);
+template bool ThreadManager::pollTarget<ApiClient::USE::FETCH_TRANSACTIONS_SOL>(ApiClient&, bool, MillisecondClock&);
\ No newline at end of file
@@ -4,26 +4,74 @@
 #define THREAD_MANAGER_HPP
 
 #include <atomic>
+#include <map>
 #include <mutex>
 #include <string>
+#include <vector>
 
 #include "ApiClient.hpp"
+#include "BackgroundLane.hpp"
 #include "MillisecondClock.hpp"
+#include "Watchlist.hpp"
+#include "WorkQueue.hpp"
 
 class MillisecondClock;
 
 class ThreadManager {
 public:
     static std::atomic<bool> isProgramActive;
-    static std::mutex consoleMutex;
 
     template<ApiClient::USE u>
-    static void sendRequest(ApiClient& client, bool verbose, MillisecondClock& clock);
+    static std::string sendRequest(ApiClient& client, bool verbose, MillisecondClock& clock);
 
-    static void runWorkerThread(const std::string& target, const std::string& network, bool verbose);
+    // probe the target and only fetch and screen it when the probe shows activity, true when it did
+    template<ApiClient::USE u>
+    static bool pollTarget(ApiClient& client, bool verbose, MillisecondClock& clock);
+
+    // one polling cycle for a target: probe, fetch and screen on whichever network it lives on
+    static bool pollNetwork(ApiClient& client, const std::string& network, bool verbose, MillisecondClock& clock);
+
+    // pull and run units of work until the queue shuts down
+    static void runWorkerThread(WorkQueue& queue);
+
+    // poll every target on a fixed pool of workers, each one due again an interval after its last poll that
+    // shrinks to minIntervalMs after activity and grows towards maxIntervalMs while the target stays idle
+    // tenants not listed in tenantWeights weigh 1. spare capacity refreshes expiring verdicts, prefetches
+    // second hops when enabled and, with backgroundBackfill, screens the history of every ethereum target
+    static void startMonitoring(const std::vector<WatchTarget>& targets, int numThreads, bool verbose,
+                                int minIntervalMs, int maxIntervalMs,
+                                const std::map<std::string, double>& tenantWeights, bool backgroundBackfill);
+
+    static void startBackfill(const std::string& target, int numThreads, bool verbose);
+
+private:
+    // where a target starts before its activity has been observed
+    static constexpr int POLL_INTERVAL_MS = 10000;
+    static constexpr double POLL_JITTER = 0.2;
+    static constexpr int METRICS_INTERVAL_MS = 60000;
+
+    // blocks per backfill chunk, the unit of parallelism and of checkpointing
+    static constexpr long long BACKFILL_CHUNK_BLOCKS = 100000;
+
+    // verdicts fetched per expiring-verdict scan of the sanctions cache
+    static constexpr size_t VERDICT_REFRESH_BATCH = 50;
+
+    // true once every transaction in the range is fetched and each counterparty got a verdict
+    static bool backfillRange(ApiClient& client, long long startBlock, long long endBlock,
+                              bool verbose, MillisecondClock& clock);
+
+    // one verdict per step, soonest to be needed first. an address the provider won't answer for is skipped
+    // until the next scan, only a lookup refused for lack of tokens is kept for the next step
+    static BackgroundLane::Job verdictRefreshJob(std::shared_ptr<WorkQueue> queue);
+
+    // the counterparties of one first-hop address per step
+    static BackgroundLane::Job prefetchJob();
 
-    static void startMonitoring(const std::string& target, const std::string& network,
-                                int numThreads, bool verbose);
+    // one backfill chunk of one ethereum target per step, target after target, checkpointed like --backfill.
+    // a chunk pages through up to a full result window and screens every counterparty in it, so unlike the
+    // other jobs' steps one can keep its worker busy for many seconds
+    static BackgroundLane::Job backfillJob(const std::vector<WatchTarget>& targets, std::shared_ptr<WorkQueue> queue,
+                                           bool verbose, MillisecondClock& clock);
 };
 
 #endif
\ No newline at end of file
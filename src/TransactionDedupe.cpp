@@ -0,0 +1,54 @@
+#include <cstring>
+
+#include "TransactionDedupe.hpp"
+
+/* storage grows with activity rather than being reserved, so idle targets stay cheap */
+TransactionDedupe::TransactionDedupe(size_t window) : window(window == 0 ? 1 : window) {}
+
+bool TransactionDedupe::parseHash(const std::string& hex, Hash& out) {
+    if (hex.length() != 66 || hex[0] != '0' || (hex[1] != 'x' && hex[1] != 'X')) return false;
+    auto nibble = [](char c) -> int {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+    for (size_t i = 0; i < out.size(); ++i) {
+        int hi = nibble(hex[2 + 2 * i]);
+        int lo = nibble(hex[3 + 2 * i]);
+        if (hi < 0 || lo < 0) return false;
+        out[i] = static_cast<uint8_t>((hi << 4) | lo);
+    }
+    return true;
+}
+
+bool TransactionDedupe::insert(const Hash& hash) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (seen.find(hash) != seen.end()) return false;
+    if (ring.size() < window) {
+        ring.push_back(hash);
+    } else {
+        seen.erase(ring[next]);
+        ring[next] = hash;
+        next = (next + 1) % window;
+    }
+    seen.insert(hash);
+    return true;
+}
+
+bool TransactionDedupe::contains(const Hash& hash) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return seen.find(hash) != seen.end();
+}
+
+size_t TransactionDedupe::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return seen.size();
+}
+
+size_t TransactionDedupe::HashHasher::operator()(const Hash& hash) const {
+    /* transaction hashes are already uniformly distributed, so any 8 bytes will do */
+    size_t value;
+    std::memcpy(&value, hash.data(), sizeof(value));
+    return value;
+}
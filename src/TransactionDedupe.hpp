@@ -0,0 +1,41 @@
+#pragma once
+#ifndef TRANSACTION_DEDUPE_HPP
+#define TRANSACTION_DEDUPE_HPP
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+class TransactionDedupe {
+public:
+    using Hash = std::array<uint8_t, 32>;
+
+    explicit TransactionDedupe(size_t window);
+
+    // decode a 0x-prefixed 64 digit hex transaction hash
+    static bool parseHash(const std::string& hex, Hash& out);
+
+    // record hash, true if it was not already in the window
+    bool insert(const Hash& hash);
+
+    bool contains(const Hash& hash);
+
+    size_t size();
+
+private:
+    struct HashHasher {
+        size_t operator()(const Hash& hash) const;
+    };
+
+    std::unordered_set<Hash, HashHasher> seen;
+    // insertion order, the oldest entry is evicted once the window is full
+    std::vector<Hash> ring;
+    size_t next = 0;
+    size_t window;
+    std::mutex mutex;
+};
+
+#endif
@@ -0,0 +1,363 @@
+#include "Transport.hpp"
+
+#include <memory>
+#include <vector>
+
+#include "Resolver.hpp"
+
+void Cancellation::cancel() {
+    std::function<void()> stopping;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requested = true;
+        stopping = stop;
+    }
+    /* outside the lock, stopping may wait for a connect under way and shouldn't hold up onCancel meanwhile */
+    if (stopping) stopping();
+}
+
+bool Cancellation::cancelled() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return requested;
+}
+
+void Cancellation::onCancel(std::function<void()> stop) {
+    bool stop_now = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->stop = stop;
+        stop_now = requested && stop;
+    }
+    if (stop_now) stop();
+}
+
+/* connections go to the cached addresses, so opening one never waits on the resolver. a connect that fails
+   moves on to the host's next address; nothing was sent yet, so the request can't go out twice */
+static httplib::Result sendToHost(const std::string& host, Cancellation* cancellation,
+                                  const std::function<httplib::Result(httplib::Client&)>& send) {
+    const std::string name = Resolver::hostName(host);
+    std::vector<std::string> addresses = Resolver::lookup(name);
+    /* a name that hasn't resolved is left to httplib, which reports the failure as usual */
+    if (addresses.empty()) addresses.push_back("");
+    httplib::Result res;
+    for (const std::string& address : addresses) {
+        auto client = std::make_shared<httplib::Client>(host);
+        /* httplib only decodes in builds with its own zlib support, and then only into a whole body */
+        client->set_decompress(false);
+        if (!address.empty()) client->set_hostname_addr_map({{name, address}});
+        /* the stop holds its own reference, so a cancel racing the end of the request never finds the client gone */
+        if (cancellation) cancellation->onCancel([client]() { client->stop(); });
+        res = send(*client);
+        if (cancellation) {
+            cancellation->onCancel(nullptr);
+            if (cancellation->cancelled()) return httplib::Result(nullptr, httplib::Error::Canceled);
+        }
+        if (res || httplib::Error::Connection != res.error() || address.empty()) return res;
+        Resolver::demote(name, address);
+    }
+    return res;
+}
+
+httplib::Result HttplibTransport::get(const std::string& host, const std::string& path,
+                                      const httplib::Headers& headers, WireStats& wire, Cancellation* cancellation) {
+    httplib::Headers compressed = headers;
+    compressed.emplace("Accept-Encoding", Decompressor::acceptEncoding());
+    std::unique_ptr<Decompressor> decompressor;
+    bool decodable = true;
+    std::string body;
+    auto res = sendToHost(host, cancellation, [&](httplib::Client& client) {
+        return client.Get(path, compressed,
+                [&](const httplib::Response& response) {
+                    const std::string encoding = response.get_header_value("Content-Encoding");
+                    if (!Decompressor::isIdentity(encoding)) decompressor = Decompressor::create(encoding);
+                    decodable = Decompressor::isIdentity(encoding) || decompressor;
+                    return decodable;
+                },
+                [&](const char* data, size_t size) {
+                    wire.bytes += static_cast<long long>(size);
+                    /* a stop landing between two reads would otherwise go unnoticed until the next one */
+                    if (cancellation && cancellation->cancelled()) return false;
+                    if (!decompressor) {
+                        body.append(data, size);
+                        return true;
+                    }
+                    /* each piece is decoded as it arrives, the compressed body is never held whole */
+                    decodable = decompressor->feed(data, size, body);
+                    return decodable;
+                });
+    });
+    if (decompressor) wire.decoding += decompressor->elapsed();
+    if (!decodable || (res && decompressor && !decompressor->finished())) {
+        return httplib::Result(nullptr, httplib::Error::Compression);
+    }
+    if (!res) return res;
+    res->body = std::move(body);
+    res->headers.erase("Content-Encoding");
+    return res;
+}
+
+httplib::Result HttplibTransport::post(const std::string& host, const std::string& path,
+                                       const httplib::Headers& headers, const std::string& body,
+                                       const std::string& contentType, WireStats& wire, Cancellation* cancellation) {
+    httplib::Headers compressed = headers;
+    compressed.emplace("Accept-Encoding", Decompressor::acceptEncoding());
+    /* httplib has no response handler for a streamed post, but account lookups answer with a few hundred bytes */
+    auto res = sendToHost(host, cancellation, [&](httplib::Client& client) {
+        return client.Post(path, compressed, body, contentType);
+    });
+    if (res && !Decompressor::decodeBody(res.value(), wire)) return httplib::Result(nullptr, httplib::Error::Compression);
+    return res;
+}
+
+#ifdef NETZ_HTTP2
+
+#include <future>
+#include <set>
+
+struct CurlTransport::Transfer {
+    CURL* easy = nullptr;
+    curl_slist* headers = nullptr;
+    // the host's cached address, as a CURLOPT_RESOLVE entry
+    curl_slist* resolve = nullptr;
+    // libcurl reads a post body from here rather than copying it
+    std::string body;
+    std::unique_ptr<httplib::Response> response = std::make_unique<httplib::Response>();
+    // set up by the first piece of the body, once the headers are in
+    std::unique_ptr<Decompressor> decompressor;
+    bool body_started = false;
+    bool decodable = true;
+    WireStats* wire = nullptr;
+    Cancellation* cancellation = nullptr;
+    std::promise<CURLcode> done;
+
+    ~Transfer() {
+        curl_slist_free_all(headers);
+        curl_slist_free_all(resolve);
+        if (easy) curl_easy_cleanup(easy);
+    }
+};
+
+CurlTransport::CurlTransport() {
+    static std::once_flag initialized;
+    std::call_once(initialized, []() { curl_global_init(CURL_GLOBAL_DEFAULT); });
+    multi = curl_multi_init();
+    if (!multi) throw std::runtime_error("Error: Could not set up the http/2 transport.");
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, MAX_CONNECTIONS_PER_HOST);
+    driver = std::thread([this]() { run(); });
+}
+
+CurlTransport::~CurlTransport() {
+    stopped = true;
+    curl_multi_wakeup(multi);
+    driver.join();
+    curl_multi_cleanup(multi);
+}
+
+httplib::Result CurlTransport::get(const std::string& host, const std::string& path,
+                                   const httplib::Headers& headers, WireStats& wire, Cancellation* cancellation) {
+    Transfer transfer;
+    transfer.easy = curl_easy_init();
+    if (!transfer.easy) return httplib::Result(nullptr, httplib::Error::Unknown);
+    curl_easy_setopt(transfer.easy, CURLOPT_URL, (host + path).c_str());
+    useCachedAddress(transfer, host);
+    for (const auto& [name, value] : headers) transfer.headers = curl_slist_append(transfer.headers, (name + ": " + value).c_str());
+    return perform(transfer, wire, cancellation);
+}
+
+httplib::Result CurlTransport::post(const std::string& host, const std::string& path,
+                                    const httplib::Headers& headers, const std::string& body,
+                                    const std::string& contentType, WireStats& wire, Cancellation* cancellation) {
+    Transfer transfer;
+    transfer.easy = curl_easy_init();
+    if (!transfer.easy) return httplib::Result(nullptr, httplib::Error::Unknown);
+    curl_easy_setopt(transfer.easy, CURLOPT_URL, (host + path).c_str());
+    useCachedAddress(transfer, host);
+    for (const auto& [name, value] : headers) transfer.headers = curl_slist_append(transfer.headers, (name + ": " + value).c_str());
+    transfer.headers = curl_slist_append(transfer.headers, ("Content-Type: " + contentType).c_str());
+    /* small json bodies, waiting for a 100 Continue would only add a round trip */
+    transfer.headers = curl_slist_append(transfer.headers, "Expect:");
+    transfer.body = body;
+    curl_easy_setopt(transfer.easy, CURLOPT_POSTFIELDS, transfer.body.data());
+    curl_easy_setopt(transfer.easy, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(transfer.body.size()));
+    return perform(transfer, wire, cancellation);
+}
+
+void CurlTransport::useCachedAddress(Transfer& transfer, const std::string& host) {
+    const std::string name = Resolver::hostName(host);
+    const std::vector<std::string> addresses = Resolver::lookup(name);
+    if (addresses.empty()) return;
+    size_t scheme_end = host.find("://");
+    std::string authority = scheme_end == std::string::npos ? host : host.substr(scheme_end + 3);
+    authority = authority.substr(0, authority.find('/'));
+    size_t colon = authority.rfind(':');
+    size_t bracket = authority.rfind(']');
+    std::string port = 0 == host.rfind("https://", 0) ? "443" : "80";
+    if (colon != std::string::npos && (bracket == std::string::npos || colon > bracket)) port = authority.substr(colon + 1);
+    /* libcurl tries every address listed when a connect fails, wants ipv6 ones in brackets, and replaces the
+       entry it has for the name when this one differs */
+    std::string entry = name + ":" + port + ":";
+    for (size_t i = 0; i < addresses.size(); ++i) {
+        if (i) entry += ",";
+        entry += addresses[i].find(':') == std::string::npos ? addresses[i] : "[" + addresses[i] + "]";
+    }
+    transfer.resolve = curl_slist_append(transfer.resolve, entry.c_str());
+    curl_easy_setopt(transfer.easy, CURLOPT_RESOLVE, transfer.resolve);
+}
+
+httplib::Result CurlTransport::perform(Transfer& transfer, WireStats& wire, Cancellation* cancellation) {
+    CURL* easy = transfer.easy;
+    /* the encoding is asked for by hand rather than with CURLOPT_ACCEPT_ENCODING, so the bytes on the wire and
+       the decoding are counted the same as with httplib */
+    transfer.headers = curl_slist_append(transfer.headers, ("Accept-Encoding: " + Decompressor::acceptEncoding()).c_str());
+    transfer.wire = &wire;
+    curl_easy_setopt(easy, CURLOPT_HTTPHEADER, transfer.headers);
+    curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    /* wait for the host's first connection to say whether it multiplexes rather than open one per request */
+    curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT, TIMEOUT_SECONDS);
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, &CurlTransport::onBody);
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, &transfer);
+    curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, &CurlTransport::onHeader);
+    curl_easy_setopt(easy, CURLOPT_HEADERDATA, &transfer);
+    curl_easy_setopt(easy, CURLOPT_PRIVATE, &transfer);
+
+    std::future<CURLcode> done = transfer.done.get_future();
+    transfer.cancellation = cancellation;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopped) return httplib::Result(nullptr, httplib::Error::Canceled);
+        pending.push_back(&transfer);
+    }
+    /* only the driver may take a transfer off the multi handle, so a cancel just wakes it to look */
+    if (cancellation) cancellation->onCancel([this]() { curl_multi_wakeup(multi); });
+    curl_multi_wakeup(multi);
+    CURLcode code = done.get();
+    if (cancellation) cancellation->onCancel(nullptr);
+    if (transfer.decompressor) wire.decoding += transfer.decompressor->elapsed();
+    if (!transfer.decodable || (CURLE_OK == code && transfer.decompressor && !transfer.decompressor->finished())) {
+        return httplib::Result(nullptr, httplib::Error::Compression);
+    }
+    if (CURLE_OK != code) return httplib::Result(nullptr, toError(code));
+    transfer.response->headers.erase("Content-Encoding");
+
+    long status = 0;
+    curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status);
+    transfer.response->status = static_cast<int>(status);
+    return httplib::Result(std::move(transfer.response), httplib::Error::Success);
+}
+
+void CurlTransport::run() {
+    std::set<Transfer*> active;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopped) break;
+            for (Transfer* transfer : pending) {
+                curl_multi_add_handle(multi, transfer->easy);
+                active.insert(transfer);
+            }
+            pending.clear();
+        }
+        int running = 0;
+        curl_multi_perform(multi, &running);
+        int left = 0;
+        while (CURLMsg* message = curl_multi_info_read(multi, &left)) {
+            if (CURLMSG_DONE != message->msg) continue;
+            CURL* easy = message->easy_handle;
+            /* the message is gone once its handle is removed */
+            CURLcode code = message->data.result;
+            Transfer* transfer = nullptr;
+            curl_easy_getinfo(easy, CURLINFO_PRIVATE, &transfer);
+            curl_multi_remove_handle(multi, easy);
+            active.erase(transfer);
+            transfer->done.set_value(code);
+        }
+        for (auto it = active.begin(); it != active.end();) {
+            Transfer* transfer = *it;
+            if (!transfer->cancellation || !transfer->cancellation->cancelled()) {
+                ++it;
+                continue;
+            }
+            curl_multi_remove_handle(multi, transfer->easy);
+            it = active.erase(it);
+            transfer->done.set_value(CURLE_ABORTED_BY_CALLBACK);
+        }
+        curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+    }
+    /* perform() turns new requests away once stopped, so only these are left to cancel */
+    std::lock_guard<std::mutex> lock(mutex);
+    active.insert(pending.begin(), pending.end());
+    pending.clear();
+    for (Transfer* transfer : active) {
+        curl_multi_remove_handle(multi, transfer->easy);
+        transfer->done.set_value(CURLE_ABORTED_BY_CALLBACK);
+    }
+}
+
+size_t CurlTransport::onBody(char* data, size_t size, size_t count, void* transfer) {
+    Transfer& t = *static_cast<Transfer*>(transfer);
+    if (!t.body_started) {
+        t.body_started = true;
+        const std::string encoding = t.response->get_header_value("Content-Encoding");
+        if (!Decompressor::isIdentity(encoding)) {
+            t.decompressor = Decompressor::create(encoding);
+            t.decodable = nullptr != t.decompressor;
+        }
+    }
+    t.wire->bytes += static_cast<long long>(size * count);
+    if (!t.decodable) return 0;
+    if (!t.decompressor) {
+        t.response->body.append(data, size * count);
+        return size * count;
+    }
+    /* a short count makes libcurl abort the transfer */
+    t.decodable = t.decompressor->feed(data, size * count, t.response->body);
+    return t.decodable ? size * count : 0;
+}
+
+size_t CurlTransport::onHeader(char* data, size_t size, size_t count, void* transfer) {
+    httplib::Response& response = *static_cast<Transfer*>(transfer)->response;
+    std::string line(data, size * count);
+    while (!line.empty() && ('\r' == line.back() || '\n' == line.back())) line.pop_back();
+    if (0 == line.rfind("HTTP/", 0)) {
+        /* a new status line, after a 1xx or a redirect, starts the headers over */
+        response.headers.clear();
+        size_t space = line.find(' ');
+        response.version = line.substr(0, space);
+        size_t reason = space == std::string::npos ? space : line.find(' ', space + 1);
+        response.reason = reason == std::string::npos ? "" : line.substr(reason + 1);
+        return size * count;
+    }
+    size_t colon = line.find(':');
+    if (colon == std::string::npos) return size * count;
+    size_t value = line.find_first_not_of(" \t", colon + 1);
+    response.headers.emplace(line.substr(0, colon), value == std::string::npos ? "" : line.substr(value));
+    return size * count;
+}
+
+httplib::Error CurlTransport::toError(CURLcode code) {
+    switch (code) {
+        case CURLE_COULDNT_RESOLVE_HOST:
+        case CURLE_COULDNT_CONNECT:
+            return httplib::Error::Connection;
+        case CURLE_SEND_ERROR:
+            return httplib::Error::Write;
+        case CURLE_RECV_ERROR:
+        case CURLE_OPERATION_TIMEDOUT:
+        case CURLE_GOT_NOTHING:
+        case CURLE_PARTIAL_FILE:
+            return httplib::Error::Read;
+        case CURLE_SSL_CONNECT_ERROR:
+            return httplib::Error::SSLConnection;
+        case CURLE_PEER_FAILED_VERIFICATION:
+            return httplib::Error::SSLServerVerification;
+        case CURLE_ABORTED_BY_CALLBACK:
+            return httplib::Error::Canceled;
+        default:
+            return httplib::Error::Unknown;
+    }
+}
+
+#endif
@@ -0,0 +1,112 @@
+#pragma once
+#ifndef TRANSPORT_HPP
+#define TRANSPORT_HPP
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Decompressor.hpp"
+#include "dependencies/httplib.h"
+
+// ends a request early from another thread; the request then comes back as Canceled
+class Cancellation {
+public:
+    void cancel();
+
+    bool cancelled() const;
+
+    // how the transport stops its request, run by cancel() or straight away if that already happened.
+    // cleared with nullptr once the request is over, though a stop already under way may still finish
+    void onCancel(std::function<void()> stop);
+
+private:
+    mutable std::mutex mutex;
+    bool requested = false;
+    std::function<void()> stop;
+};
+
+// how ApiClient puts a provider request on the wire. called from any worker thread, blocking until the
+// response or the error that ended the request is in. responses come back decoded, with what they took on the
+// wire added to wire. a request given a cancellation gives up its connection once it is cancelled
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    // host as in ApiClient::URLs, scheme://name[:port]
+    virtual httplib::Result get(const std::string& host, const std::string& path, const httplib::Headers& headers,
+                                WireStats& wire, Cancellation* cancellation = nullptr) = 0;
+
+    virtual httplib::Result post(const std::string& host, const std::string& path, const httplib::Headers& headers,
+                                 const std::string& body, const std::string& contentType, WireStats& wire,
+                                 Cancellation* cancellation = nullptr) = 0;
+};
+
+// the default: a fresh httplib::Client per request, http/1.1 with one request per connection at a time
+class HttplibTransport : public Transport {
+public:
+    httplib::Result get(const std::string& host, const std::string& path, const httplib::Headers& headers,
+                        WireStats& wire, Cancellation* cancellation = nullptr) override;
+
+    httplib::Result post(const std::string& host, const std::string& path, const httplib::Headers& headers,
+                         const std::string& body, const std::string& contentType, WireStats& wire,
+                         Cancellation* cancellation = nullptr) override;
+};
+
+// opt in with -DNETZ_CURL and -lcurl
+#if defined(NETZ_CURL) && __has_include(<curl/curl.h>)
+#define NETZ_HTTP2 1
+
+#include <curl/curl.h>
+
+// http/2 through libcurl's multi interface: one thread drives every transfer, and requests to the same host
+// from all workers go out as streams on a shared connection instead of a socket each. hosts without http/2,
+// and plain http, fall back to http/1.1 on a few kept-alive connections
+class CurlTransport : public Transport {
+public:
+    CurlTransport();
+    ~CurlTransport() override;
+
+    CurlTransport(const CurlTransport&) = delete;
+    CurlTransport& operator=(const CurlTransport&) = delete;
+
+    httplib::Result get(const std::string& host, const std::string& path, const httplib::Headers& headers,
+                        WireStats& wire, Cancellation* cancellation = nullptr) override;
+
+    httplib::Result post(const std::string& host, const std::string& path, const httplib::Headers& headers,
+                         const std::string& body, const std::string& contentType, WireStats& wire,
+                         Cancellation* cancellation = nullptr) override;
+
+    constexpr static long TIMEOUT_SECONDS = 30;
+    // connections per host; with http/2 the first one carries every stream, the rest serve http/1.1 hosts
+    constexpr static long MAX_CONNECTIONS_PER_HOST = 8;
+
+private:
+    struct Transfer;
+
+    static void useCachedAddress(Transfer& transfer, const std::string& host);
+
+    httplib::Result perform(Transfer& transfer, WireStats& wire, Cancellation* cancellation);
+
+    void run();
+
+    static size_t onBody(char* data, size_t size, size_t count, void* transfer);
+
+    static size_t onHeader(char* data, size_t size, size_t count, void* transfer);
+
+    static httplib::Error toError(CURLcode code);
+
+    CURLM* multi = nullptr;
+    std::thread driver;
+    std::mutex mutex;
+    // handed over by workers, added to the multi handle by the driver
+    std::vector<Transfer*> pending;
+    std::atomic<bool> stopped{false};
+};
+
+#endif
+
+#endif
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#include "AddressValidator.hpp"
+#include "Watchlist.hpp"
+
+namespace {
+
+struct Rejected {
+    size_t line;
+    std::string reason;
+};
+
+struct Chunk {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    size_t lines = 0;
+    std::vector<WatchTarget> targets;
+    std::vector<size_t> target_lines;
+    std::vector<Rejected> rejected;
+};
+
+bool isSeparator(char c) {
+    return c == ' ' || c == '\t' || c == ',' || c == '\r';
+}
+
+std::string_view nextField(const char*& pos, const char* end) {
+    while (pos < end && isSeparator(*pos)) ++pos;
+    const char* start = pos;
+    while (pos < end && !isSeparator(*pos)) ++pos;
+    return std::string_view(start, static_cast<size_t>(pos - start));
+}
+
+void parseChunk(Chunk& chunk) {
+    /* roughly one line per 48 bytes for the longest addresses, enough to avoid most regrowth */
+    chunk.targets.reserve(static_cast<size_t>(chunk.end - chunk.begin) / 48);
+    const char* pos = chunk.begin;
+    while (pos < chunk.end) {
+        const char* eol = static_cast<const char*>(std::memchr(pos, '\n', static_cast<size_t>(chunk.end - pos)));
+        if (!eol) eol = chunk.end;
+        size_t line = chunk.lines++;
+        std::string_view network = nextField(pos, eol);
+        if (!network.empty() && network[0] != '#') {
+            std::string_view address = nextField(pos, eol);
+            std::string_view priority_name = nextField(pos, eol);
+            Priority priority = Priority::NORMAL;
+            const std::string& canonical = AddressValidator::canonicalNetwork(network);
+            if (canonical.empty()) {
+                chunk.rejected.push_back({line, "unknown network " + std::string(network)});
+            } else if (!AddressValidator::isValid(canonical, address)) {
+                chunk.rejected.push_back({line, "invalid " + canonical + " address " + std::string(address)});
+            } else if (!priority_name.empty() && priority_name[0] != '#' && !Priorities::parse(priority_name, priority)) {
+                chunk.rejected.push_back({line, "unknown priority " + std::string(priority_name)});
+            } else {
+                chunk.targets.push_back({canonical, AddressValidator::canonicalAddress(canonical, address), priority});
+                chunk.target_lines.push_back(line);
+            }
+        }
+        pos = eol + 1;
+    }
+}
+
+}
+
+std::vector<WatchTarget> Watchlist::load(const std::string& path) {
+    auto started = std::chrono::steady_clock::now();
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Error: Cannot open watchlist " + path);
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("Error: Cannot stat watchlist " + path);
+    }
+    const size_t size = static_cast<size_t>(info.st_size);
+    if (0 == size) {
+        close(fd);
+        return {};
+    }
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) throw std::runtime_error("Error: Cannot map watchlist " + path);
+    madvise(mapped, size, MADV_SEQUENTIAL);
+    const char* data = static_cast<const char*>(mapped);
+
+    /* cut the file into one chunk per core, each ending just after a newline */
+    const size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<Chunk> chunks;
+    const char* begin = data;
+    for (size_t i = 1; i <= workers && begin < data + size; ++i) {
+        const char* end = data + size * i / workers;
+        if (end < begin) end = begin;
+        const char* newline = static_cast<const char*>(std::memchr(end, '\n', static_cast<size_t>(data + size - end)));
+        end = (i == workers || !newline) ? data + size : newline + 1;
+        Chunk chunk;
+        chunk.begin = begin;
+        chunk.end = end;
+        chunks.push_back(std::move(chunk));
+        begin = end;
+    }
+    std::vector<std::thread> parsers;
+    for (Chunk& chunk : chunks) {
+        parsers.emplace_back([&chunk]() { parseChunk(chunk); });
+    }
+    for (auto& parser : parsers) parser.join();
+    munmap(mapped, size);
+
+    size_t parsed_count = 0;
+    for (const Chunk& chunk : chunks) parsed_count += chunk.targets.size();
+    std::vector<WatchTarget> parsed;
+    std::vector<size_t> parsed_lines;
+    std::vector<Rejected> rejected;
+    parsed.reserve(parsed_count);
+    parsed_lines.reserve(parsed_count);
+    size_t line_offset = 1;
+    for (Chunk& chunk : chunks) {
+        for (size_t i = 0; i < chunk.targets.size(); ++i) {
+            parsed.push_back(std::move(chunk.targets[i]));
+            parsed_lines.push_back(chunk.target_lines[i] + line_offset);
+        }
+        for (Rejected& reject : chunk.rejected) {
+            reject.line += line_offset;
+            rejected.push_back(std::move(reject));
+        }
+        line_offset += chunk.lines;
+    }
+
+    /* shard the duplicate check by hash; each shard is an open-addressed table of indices into parsed,
+       visited in file order so the first occurrence is the one kept */
+    std::vector<size_t> hashes(parsed.size());
+    std::vector<char> duplicate(parsed.size(), 0);
+    for (size_t i = 0; i < parsed.size(); ++i) {
+        hashes[i] = std::hash<std::string>{}(parsed[i].address) * 31 + static_cast<size_t>(parsed[i].network[0]);
+    }
+    std::vector<std::thread> dedupers;
+    for (size_t shard = 0; shard < workers; ++shard) {
+        dedupers.emplace_back([&, shard]() {
+            size_t capacity = 16;
+            while (capacity < 2 * parsed.size() / workers + 2) capacity <<= 1;
+            std::vector<size_t> slots(capacity, SIZE_MAX);
+            for (size_t i = 0; i < parsed.size(); ++i) {
+                if (hashes[i] % workers != shard) continue;
+                size_t slot = (hashes[i] / workers) & (capacity - 1);
+                while (slots[slot] != SIZE_MAX) {
+                    size_t j = slots[slot];
+                    if (hashes[j] == hashes[i] && parsed[j].address == parsed[i].address
+                        && parsed[j].network == parsed[i].network) {
+                        duplicate[i] = 1;
+                        break;
+                    }
+                    slot = (slot + 1) & (capacity - 1);
+                }
+                if (!duplicate[i]) slots[slot] = i;
+            }
+        });
+    }
+    for (auto& deduper : dedupers) deduper.join();
+
+    std::vector<WatchTarget> targets;
+    targets.reserve(parsed.size());
+    size_t duplicates = 0;
+    for (size_t i = 0; i < parsed.size(); ++i) {
+        if (duplicate[i]) {
+            if (++duplicates <= MAX_REPORTED_LINES) {
+                std::cerr << path << ":" << parsed_lines[i] << ": duplicate " << parsed[i].network << " address "
+                          << parsed[i].address << ", skipping\n";
+            }
+            continue;
+        }
+        targets.push_back(std::move(parsed[i]));
+    }
+    std::sort(rejected.begin(), rejected.end(), [](const Rejected& a, const Rejected& b) { return a.line < b.line; });
+    for (size_t i = 0; i < rejected.size() && i < MAX_REPORTED_LINES; ++i) {
+        std::cerr << path << ":" << rejected[i].line << ": " << rejected[i].reason << ", skipping\n";
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+    std::cout << "Loaded " << targets.size() << " targets from " << path << " in " << elapsed.count() << "ms ("
+              << duplicates << " duplicates, " << rejected.size() << " invalid lines skipped)\n";
+    return targets;
+}
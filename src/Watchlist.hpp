@@ -0,0 +1,30 @@
+#pragma once
+#ifndef WATCHLIST_HPP
+#define WATCHLIST_HPP
+
+#include <string>
+#include <vector>
+
+#include "Priority.hpp"
+
+struct WatchTarget {
+    std::string network;
+    std::string address;
+    Priority priority = Priority::NORMAL;
+    // the team the target is watched for, tenants share the workers and api keys by weight
+    std::string tenant = "default";
+};
+
+class Watchlist {
+public:
+    // one "<network> <address> [low|normal|high]" entry per line, blank lines and # comments are skipped.
+    // the file is memory-mapped and validated in parallel chunks; invalid lines and repeated
+    // addresses are reported and dropped, addresses come back in canonical form
+    static std::vector<WatchTarget> load(const std::string& path);
+
+private:
+    // per kind of problem, so a broken million-line file doesn't flood the console
+    static constexpr size_t MAX_REPORTED_LINES = 10;
+};
+
+#endif
@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <iterator>
+
+#include "WorkQueue.hpp"
+
+namespace {
+
+/* the queue a worker thread belongs to and its deque there */
+thread_local const void* worker_queue = nullptr;
+thread_local void* worker_deque = nullptr;
+/* the unit the thread is running, 0 outside any */
+thread_local uint64_t running_unit = 0;
+
+/* puts back the unit that was running when a nested one returns, or throws */
+struct UnitScope {
+    explicit UnitScope(uint64_t unit) : outer(running_unit) { running_unit = unit; }
+    ~UnitScope() { running_unit = outer; }
+    uint64_t outer;
+};
+
+}
+
+void WorkQueue::push(Task task, Priority priority, size_t tenant) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        /* a tenant that sat idle starts from the current virtual time instead of spending credit it banked meanwhile */
+        auto weight = weights.find(tenant);
+        double start = std::max(virtual_clock, finish_tags[tenant]);
+        double finish = start + 1.0 / (weight == weights.end() ? 1.0 : weight->second);
+        finish_tags[tenant] = finish;
+        lanes[static_cast<size_t>(priority)][tenant].push_back({asUnit(std::move(task)), start, finish});
+        shared_count++;
+    }
+    available.notify_one();
+}
+
+void WorkQueue::setTenantWeight(size_t tenant, double weight) {
+    std::lock_guard<std::mutex> lock(mutex);
+    weights[tenant] = weight;
+}
+
+bool WorkQueue::takeNext(Task& task) {
+    for (size_t lane = Priorities::COUNT; lane-- > 0;) {
+        /* the tenant whose next task finishes first in virtual time goes next */
+        std::deque<Tagged>* next = nullptr;
+        for (auto& [tenant, pending] : lanes[lane]) {
+            if (!pending.empty() && (!next || pending.front().finish < next->front().finish)) next = &pending;
+        }
+        if (!next) continue;
+        task = std::move(next->front().task);
+        virtual_clock = std::max(virtual_clock, next->front().start);
+        next->pop_front();
+        shared_count--;
+        return true;
+    }
+    return false;
+}
+
+WorkQueue::Task WorkQueue::asUnit(Task task) {
+    uint64_t unit = next_unit++;
+    return [task = std::move(task), unit]() {
+        UnitScope scope(unit);
+        task();
+    };
+}
+
+WorkQueue::Local* WorkQueue::localDeque() {
+    return worker_queue == this ? static_cast<Local*>(worker_deque) : nullptr;
+}
+
+bool WorkQueue::pushLocal(Task& task) {
+    Local* local = localDeque();
+    if (!local) return false;
+    {
+        std::lock_guard<std::mutex> lock(local->mutex);
+        local->tasks.push_back({asUnit(std::move(task)), running_unit});
+    }
+    local_count++;
+    /* taking the lock orders this against a worker that just found nothing and is about to sleep */
+    { std::lock_guard<std::mutex> lock(mutex); }
+    available.notify_one();
+    return true;
+}
+
+bool WorkQueue::popLocal(Local* local, Task& task) {
+    if (!local) return false;
+    std::lock_guard<std::mutex> lock(local->mutex);
+    if (local->tasks.empty()) return false;
+    task = std::move(local->tasks.back().task);
+    local->tasks.pop_back();
+    local_count--;
+    return true;
+}
+
+bool WorkQueue::popChild(Task& task) {
+    Local* local = localDeque();
+    if (!local || 0 == running_unit) return false;
+    std::lock_guard<std::mutex> lock(local->mutex);
+    /* a nested unit that didn't wait for all of its own may have left them on top */
+    for (auto subtask = local->tasks.rbegin(); subtask != local->tasks.rend(); ++subtask) {
+        if (subtask->parent != running_unit) continue;
+        task = std::move(subtask->task);
+        local->tasks.erase(std::next(subtask).base());
+        local_count--;
+        return true;
+    }
+    return false;
+}
+
+bool WorkQueue::steal(Local* thief, Task& task) {
+    if (0 == local_count.load()) return false;
+    std::vector<Local*> victims;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& local : locals) {
+            if (local.get() != thief) victims.push_back(local.get());
+        }
+    }
+    for (Local* victim : victims) {
+        std::lock_guard<std::mutex> lock(victim->mutex);
+        if (victim->tasks.empty()) continue;
+        task = std::move(victim->tasks.front().task);
+        victim->tasks.pop_front();
+        local_count--;
+        return true;
+    }
+    return false;
+}
+
+bool WorkQueue::pop(Task& task) {
+    Local* local = localDeque();
+    if (!local) {
+        std::lock_guard<std::mutex> lock(mutex);
+        locals.push_back(std::make_unique<Local>());
+        local = locals.back().get();
+        worker_queue = this;
+        worker_deque = local;
+    }
+    while (true) {
+        if (popLocal(local, task)) return true;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopped) break;
+            if (takeNext(task)) return true;
+        }
+        if (steal(local, task)) return true;
+        std::unique_lock<std::mutex> lock(mutex);
+        available.wait(lock, [this]() { return stopped || 0 != shared_count || 0 != local_count.load(); });
+        if (stopped) break;
+    }
+    /* the worker is done with this queue */
+    worker_queue = nullptr;
+    worker_deque = nullptr;
+    return false;
+}
+
+bool WorkQueue::tryPop(Task& task) {
+    Local* local = localDeque();
+    if (popLocal(local, task)) return true;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopped) return false;
+        if (takeNext(task)) return true;
+    }
+    return steal(local, task);
+}
+
+void WorkQueue::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+        for (auto& lane : lanes) lane.clear();
+        shared_count = 0;
+        for (auto& local : locals) {
+            std::lock_guard<std::mutex> local_lock(local->mutex);
+            local->tasks.clear();
+        }
+        local_count = 0;
+    }
+    available.notify_all();
+}
+
+size_t WorkQueue::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return shared_count + local_count.load();
+}
@@ -0,0 +1,123 @@
+#pragma once
+#ifndef WORK_QUEUE_HPP
+#define WORK_QUEUE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Priority.hpp"
+
+// a work-stealing executor: scheduled work enters a shared queue ordered by priority and tenant, while the
+// sub-units a worker submits go on that worker's own deque, newest first for the owner and oldest first
+// for idle workers stealing from it
+class WorkQueue {
+public:
+    using Task = std::function<void()>;
+
+    // higher priority tasks are popped first; within a priority, tenants are served by weighted fair
+    // queuing and each tenant's tasks in the order they were pushed
+    void push(Task task, Priority priority = Priority::NORMAL, size_t tenant = 0);
+
+    // share of the workers a tenant gets while others are waiting too, 1 unless set
+    void setTenantWeight(size_t tenant, double weight);
+
+    // block until a task is available, false once the queue is shut down; the calling
+    // thread becomes one of the queue's workers with a deque of its own
+    bool pop(Task& task);
+
+    bool tryPop(Task& task);
+
+    // queue fn as its own unit of work and hand back its result. from one of the queue's workers it goes on
+    // that worker's deque, inheriting the priority and tenant of the work that spawned it
+    template<typename F>
+    auto submit(F&& fn, Priority priority = Priority::NORMAL, size_t tenant = 0) -> std::future<decltype(fn())> {
+        using R = decltype(fn());
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(fn));
+        std::future<R> future = task->get_future();
+        Task unit = [task]() { (*task)(); };
+        if (!pushLocal(unit)) push(std::move(unit), priority, tenant);
+        return future;
+    }
+
+    // run the sub-units the calling unit submitted on its own thread until future is ready, so a unit waiting
+    // on them never leaves its worker idle or deadlocks a small pool. unrelated work is left to the other
+    // workers, and once none of its own sub-units is left to run the caller blocks
+    template<typename T>
+    T waitFor(std::future<T>& future) {
+        while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            Task task;
+            if (popChild(task)) task();
+            else future.wait();
+        }
+        return future.get();
+    }
+
+    void shutdown();
+
+    size_t size();
+
+private:
+    // a sub-unit and the unit that submitted it
+    struct Subtask {
+        Task task;
+        uint64_t parent;
+    };
+
+    struct Local {
+        std::deque<Subtask> tasks;
+        std::mutex mutex;
+    };
+
+    // task wrapped to run as a unit of its own, so the sub-units it submits can be told from others
+    Task asUnit(Task task);
+
+    // false when every lane is empty
+    bool takeNext(Task& task);
+
+    // the calling thread's deque if it is one of this queue's workers
+    Local* localDeque();
+
+    // false when the calling thread is not one of this queue's workers
+    bool pushLocal(Task& task);
+
+    bool popLocal(Local* local, Task& task);
+
+    // newest task on the calling worker's deque submitted by the unit it is running
+    bool popChild(Task& task);
+
+    // oldest task of another worker's deque
+    bool steal(Local* thief, Task& task);
+
+    // a task with its virtual start and finish time, tagged when it is pushed
+    struct Tagged {
+        Task task;
+        double start;
+        double finish;
+    };
+
+    // per priority, each tenant's pending tasks
+    std::map<size_t, std::deque<Tagged>> lanes[Priorities::COUNT];
+    std::map<size_t, double> weights;
+    // finish time of each tenant's last pushed task, and the start time of the last task popped
+    std::map<size_t, double> finish_tags;
+    double virtual_clock = 0;
+    size_t shared_count = 0;
+    // deques are only ever added, so their addresses stay valid
+    std::vector<std::unique_ptr<Local>> locals;
+    std::atomic<size_t> local_count{0};
+    std::atomic<uint64_t> next_unit{1};
+    std::mutex mutex;
+    std::condition_variable available;
+    bool stopped = false;
+};
+
+#endif
@@ -1,9 +1,19 @@
 #include <iostream>
 #include <string>
 #include <csignal>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <vector>
 
 #include "CliClient.hpp"
+#include "Hedging.hpp"
+#include "KeyPool.hpp"
+#include "RateLimiter.hpp"
+#include "Resolver.hpp"
 #include "ThreadManager.hpp"
+#include "Transport.hpp"
+#include "Watchlist.hpp"
 
 void signalHandler(int signal) {
    std::cout << "\nReceived interrupt signal. Shutting down gracefully..." << std::endl;
@@ -14,31 +24,78 @@ int main(int argc, char* argv[]) {
    std::signal(SIGINT, signalHandler);
    std::signal(SIGTERM, signalHandler);
 
-   std::string target = "";
-   std::string network = "ethereum";
-   int numThreads = 1;
-   bool verbose = false;
+   CliClient::Options options;
 
    try {
-      CliClient::parseArguments(argc, argv, numThreads, target, network);
+      CliClient::parseArguments(argc, argv, options);
 
-      for (int i = 1; i < argc; ++i) {
-         std::string arg = argv[i];
-         if (arg == "--verbose" || arg == "-v") {
-            verbose = true;
-            break;
-         }
-      }
-
-      if (target.empty()) {
-         std::cerr << "Error: Target address is required. Use --target or -ta flag." << std::endl;
+      if (options.target.empty() && options.watchlists.empty()) {
+         std::cerr << "Error: Target address is required. Use --target or -ta flag, or --watchlist." << std::endl;
          std::cerr << "Use --help for usage information." << std::endl;
          return EXIT_FAILURE;
       }
+      /* the providers' names resolve while the rest starts up rather than on the first poll */
+      const ApiClient::URLs urls;
+      Resolver::warm({urls.etherscan_url, urls.chainalysis_url, urls.tron_url, urls.shyft_url});
 
-      CliClient::printBanner(target, network, numThreads);
+      /* --target and the watchlists are all canonical by now, so a target named twice is polled once, for the
+         first place it was named */
+      std::vector<WatchTarget> targets;
+      std::set<std::pair<std::string, std::string>> seen;
+      size_t duplicates = 0;
+      for (const auto& [network, address] : options.targets) {
+         seen.insert({network, address});
+         targets.push_back({network, address});
+      }
+      for (const auto& [tenant, path] : options.watchlists) {
+         for (WatchTarget& target : Watchlist::load(path)) {
+            if (!seen.insert({target.network, target.address}).second) {
+               duplicates++;
+               continue;
+            }
+            target.tenant = tenant;
+            targets.push_back(std::move(target));
+         }
+      }
+      if (duplicates) std::cerr << "Skipped " << duplicates << " targets already given earlier" << std::endl;
 
-      ThreadManager::startMonitoring(target, network, numThreads, verbose);
+      std::string banner_target = 1 == targets.size()
+         ? targets.front().address
+         : std::to_string(targets.size()) + " targets"
+           + (1 == options.watchlists.size() ? " from " + options.watchlists.front().second
+              : options.watchlists.empty() ? "" : " from " + std::to_string(options.watchlists.size()) + " watchlists");
+      std::string banner_network = 1 == targets.size() ? targets.front().network : "mixed";
+      CliClient::printBanner(banner_target, banner_network, options.numThreads);
+      ApiClient::setDedupeWindow(options.dedupeWindow);
+      ApiClient::setPrefetch(options.prefetch);
+      ApiClient::setFullPayloads(options.fullPayloads);
+      Hedging::configure(options.hedgePercentile, options.hedgeBudgetPercent / 100.0);
+      if (options.http2) {
+#ifdef NETZ_HTTP2
+         ApiClient::setTransport(std::make_shared<CurlTransport>());
+#else
+         throw std::runtime_error("Error: --http2 needs a build with -DNETZ_CURL and -lcurl.");
+#endif
+      }
+      for (const auto& spec : options.keyRates) RateLimiter::setKeyRate(spec.provider, spec.rate, spec.burst);
+      for (const auto& spec : options.providerRates) RateLimiter::setProviderRate(spec.provider, spec.rate, spec.burst);
+      for (const auto& [operation, cost] : options.requestCosts) {
+         size_t colon = operation.find(':');
+         RateLimiter::setCost(operation.substr(0, colon), operation.substr(colon + 1), cost);
+      }
+      RateLimiter::setPolicy(options.dropWhenLimited ? RateLimiter::DROP : RateLimiter::WAIT);
+      KeyPool::load();
+
+      if (options.backfill) {
+         ThreadManager::startBackfill(options.target, options.numThreads, options.verbose);
+      } else if (targets.empty()) {
+         std::cerr << "Error: No valid targets in the given watchlists." << std::endl;
+         return EXIT_FAILURE;
+      } else {
+         ThreadManager::startMonitoring(targets, options.numThreads, options.verbose,
+                                        options.minPollMs, options.maxPollMs, options.tenantWeights,
+                                        options.backgroundBackfill);
+      }
    } catch (const std::exception& e) {
       std::cerr << "Fatal error: " << e.what() << std::endl;
       return EXIT_FAILURE;
@@ -0,0 +1,131 @@
+#include <atomic>
+#include <cstdio>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Async.hpp"
+
+/*
+ * Errors thrown inside coroutines: a WhenAll child that throws has its error rethrown to whoever awaits the
+ * WhenAll, after the other children finished, and a task run with Async::start hands its error to the failed
+ * callback instead of ending the process. Needs -std=c++20.
+ */
+
+#ifndef NETZ_COROUTINES
+int main() {
+    std::printf("built without coroutines, nothing to test\n");
+    return 0;
+}
+#else
+
+static int failures = 0;
+
+static void expect(bool ok, const char* test, const std::string& what) {
+    if (ok) return;
+    failures++;
+    std::printf("FAIL %s: %s\n", test, what.c_str());
+}
+
+static std::atomic<int> finished{0};
+
+// sleeps first, so it finishes on the loop thread, then returns or throws
+static Async<int> child(EventLoop& loop, int value, bool fail) {
+    co_await Sleep{loop, 0.01 * value};
+    if (fail) throw std::runtime_error("child " + std::to_string(value) + " failed");
+    finished++;
+    co_return value;
+}
+
+// throws before it ever suspends, on the thread starting it
+static Async<int> failsAtOnce() {
+    throw std::runtime_error("failed at once");
+    co_return 0;
+}
+
+static Async<std::string> gather(EventLoop& loop, bool fail_late, bool fail_early) {
+    std::vector<Async<int>> tasks;
+    tasks.push_back(child(loop, 1, false));
+    tasks.push_back(child(loop, 2, fail_late));
+    if (fail_early) tasks.push_back(failsAtOnce());
+    tasks.push_back(child(loop, 3, false));
+    try {
+        std::vector<int> values = co_await WhenAll<int>{std::move(tasks)};
+        int sum = 0;
+        for (int value : values) sum += value;
+        co_return "sum " + std::to_string(sum);
+    } catch (const std::exception& e) {
+        co_return std::string("caught ") + e.what();
+    }
+}
+
+// run task on loop and wait for what it returns or throws
+static std::string outcome(Async<std::string> task) {
+    std::promise<std::string> done;
+    Async<std::string>::start(std::move(task), [&done](std::string result) { done.set_value(std::move(result)); },
+                              [&done](std::exception_ptr error) {
+                                  try {
+                                      std::rethrow_exception(error);
+                                  } catch (const std::exception& e) {
+                                      done.set_value(std::string("failed ") + e.what());
+                                  }
+                              });
+    return done.get_future().get();
+}
+
+static void whenAllSucceeds(EventLoop& loop) {
+    finished = 0;
+    std::string result = outcome(gather(loop, false, false));
+    expect("sum 6" == result, __func__, result);
+    expect(3 == finished, __func__, std::to_string(finished) + " children finished instead of 3");
+}
+
+static void whenAllRethrowsChildError(EventLoop& loop) {
+    finished = 0;
+    std::string result = outcome(gather(loop, true, false));
+    expect("caught child 2 failed" == result, __func__, result);
+    /* the awaiting coroutine only resumes once the children that didn't throw are done too */
+    expect(2 == finished, __func__, std::to_string(finished) + " children finished instead of 2");
+
+    finished = 0;
+    result = outcome(gather(loop, false, true));
+    expect("caught failed at once" == result, __func__, result);
+    expect(3 == finished, __func__, std::to_string(finished) + " children finished instead of 3");
+}
+
+static Async<std::string> throws(EventLoop& loop) {
+    co_await Sleep{loop, 0.01};
+    throw std::runtime_error("poll failed");
+}
+
+static void startReportsError(EventLoop& loop) {
+    std::string result = outcome(throws(loop));
+    expect("failed poll failed" == result, __func__, result);
+
+    /* with no failed callback the error is only logged, and the loop carries on */
+    Async<std::string>::start(throws(loop), [](std::string) {});
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    result = outcome(gather(loop, false, false));
+    expect("sum 6" == result, __func__, "after an unhandled error: " + result);
+}
+
+int main() {
+    EventLoop loop;
+    std::thread runner([&loop]() { loop.run(); });
+    const std::vector<std::pair<const char*, void (*)(EventLoop&)>> tests = {
+            {"whenAllSucceeds", whenAllSucceeds},
+            {"whenAllRethrowsChildError", whenAllRethrowsChildError},
+            {"startReportsError", startReportsError},
+    };
+    for (const auto& test : tests) {
+        int before = failures;
+        test.second(loop);
+        std::printf("%s %s\n", before == failures ? "ok  " : "FAIL", test.first);
+    }
+    loop.stop();
+    runner.join();
+    return failures ? 1 : 0;
+}
+#endif
@@ -0,0 +1,199 @@
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <future>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "EventLoop.hpp"
+
+/*
+ * The event loop's response parser and its retry of dead kept-alive connections, against a server that writes
+ * raw bytes. Every response goes out in pieces with a pause between them, so each piece reaches the loop in a
+ * read of its own and the parser has to pick up where the last read ended.
+ */
+
+static const int PIECE_PAUSE_MS = 20;
+
+class ScriptedServer {
+public:
+    // serve runs on a thread of its own for every connection accepted, with the connection's socket, which is
+    // closed once it returns
+    explicit ScriptedServer(std::function<void(int)> serve) : serve(std::move(serve)) {
+        listening = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(listening, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        socklen_t length = sizeof(address);
+        getsockname(listening, reinterpret_cast<sockaddr*>(&address), &length);
+        port = ntohs(address.sin_port);
+        ::listen(listening, SOMAXCONN);
+        thread = std::thread([this]() { acceptLoop(); });
+    }
+
+    ~ScriptedServer() {
+        shutdown(listening, SHUT_RDWR);
+        ::close(listening);
+        thread.join();
+        for (std::thread& connection : connections) connection.join();
+    }
+
+    std::string url() const {
+        return "http://127.0.0.1:" + std::to_string(port);
+    }
+
+    // read one request's head, false when the client closed first
+    static bool readRequest(int fd) {
+        std::string head;
+        char buffer[1024];
+        while (std::string::npos == head.find("\r\n\r\n")) {
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) return false;
+            head.append(buffer, static_cast<size_t>(n));
+        }
+        return true;
+    }
+
+    static void write(int fd, const std::vector<std::string>& pieces) {
+        for (const std::string& piece : pieces) {
+            send(fd, piece.data(), piece.size(), MSG_NOSIGNAL);
+            std::this_thread::sleep_for(std::chrono::milliseconds(PIECE_PAUSE_MS));
+        }
+    }
+
+    std::atomic<int> accepted{0};
+
+private:
+    void acceptLoop() {
+        while (true) {
+            int fd = accept(listening, nullptr, nullptr);
+            if (fd < 0) return;
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            accepted++;
+            connections.emplace_back([this, fd]() {
+                serve(fd);
+                ::close(fd);
+            });
+        }
+    }
+
+    std::function<void(int)> serve;
+    int listening = -1;
+    int port = 0;
+    std::thread thread;
+    std::vector<std::thread> connections;
+};
+
+static int failures = 0;
+
+static void expect(bool ok, const char* test, const std::string& what) {
+    if (ok) return;
+    failures++;
+    std::printf("FAIL %s: %s\n", test, what.c_str());
+}
+
+static httplib::Result fetch(EventLoop& loop, const std::string& host, const std::string& path = "/") {
+    std::promise<httplib::Result> done;
+    auto result = done.get_future();
+    loop.send({"GET", host, path, {}, ""}, [&done](httplib::Result res, const WireStats&) {
+        done.set_value(std::move(res));
+    });
+    return result.get();
+}
+
+static std::string describe(const httplib::Result& res) {
+    if (!res) return "error " + httplib::to_string(res.error());
+    return std::to_string(res->status) + " '" + res->body + "'";
+}
+
+static void splitChunkHeaders(EventLoop& loop) {
+    ScriptedServer server([](int fd) {
+        if (!ScriptedServer::readRequest(fd)) return;
+        ScriptedServer::write(fd, {"HTTP/1.1 200 OK\r\nTransfer-Enc", "oding: chunked\r", "\n\r\n5", "\r\nhel",
+                                   "lo\r", "\n6;ext=1\r\n worl", "d\r\n0\r", "\n\r\n"});
+    });
+    auto res = fetch(loop, server.url());
+    expect(res && 200 == res->status && "hello world" == res->body, __func__, describe(res));
+}
+
+static void trailers(EventLoop& loop) {
+    ScriptedServer server([](int fd) {
+        if (!ScriptedServer::readRequest(fd)) return;
+        ScriptedServer::write(fd, {"HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n0\r\n",
+                                   "X-Checksum: abc\r\nX-Ot", "her: 1\r\n", "\r\n"});
+        /* the next response on the connection only parses if the trailers were consumed to the last byte */
+        if (!ScriptedServer::readRequest(fd)) return;
+        ScriptedServer::write(fd, {"HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok"});
+    });
+    auto first = fetch(loop, server.url());
+    expect(first && "hello" == first->body, __func__, "first: " + describe(first));
+    auto second = fetch(loop, server.url());
+    expect(second && "ok" == second->body, __func__, "second: " + describe(second));
+    expect(1 == server.accepted, __func__, std::to_string(server.accepted) + " connections instead of 1");
+}
+
+static void closedMidBody(EventLoop& loop) {
+    ScriptedServer sized([](int fd) {
+        if (!ScriptedServer::readRequest(fd)) return;
+        ScriptedServer::write(fd, {"HTTP/1.1 200 OK\r\nContent-Length: 100\r\n\r\npart", "ial"});
+    });
+    auto res = fetch(loop, sized.url());
+    expect(!res && httplib::Error::Read == res.error(), __func__, "content-length: " + describe(res));
+
+    ScriptedServer chunked([](int fd) {
+        if (!ScriptedServer::readRequest(fd)) return;
+        ScriptedServer::write(fd, {"HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n10\r\npart", "ial"});
+    });
+    res = fetch(loop, chunked.url());
+    expect(!res && httplib::Error::Read == res.error(), __func__, "chunked: " + describe(res));
+    /* a fresh connection may have delivered the request, so it must not be sent again */
+    expect(1 == chunked.accepted, __func__, std::to_string(chunked.accepted) + " connections instead of 1");
+}
+
+static void reusedSocketDies(EventLoop& loop) {
+    std::atomic<int> served{0};
+    ScriptedServer server([&served](int fd) {
+        if (!ScriptedServer::readRequest(fd)) return;
+        /* the first connection answers once and then dies on the next request, as an idle timeout would */
+        if (0 == served++) {
+            ScriptedServer::write(fd, {"HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nfirst"});
+            ScriptedServer::readRequest(fd);
+            return;
+        }
+        ScriptedServer::write(fd, {"HTTP/1.1 200 OK\r\nContent-Length: 6\r\n\r\nsecond"});
+    });
+    auto first = fetch(loop, server.url());
+    expect(first && "first" == first->body, __func__, "first: " + describe(first));
+    auto second = fetch(loop, server.url());
+    expect(second && "second" == second->body, __func__, "second: " + describe(second));
+    expect(2 == server.accepted, __func__, std::to_string(server.accepted) + " connections instead of 2");
+}
+
+int main() {
+    EventLoop loop;
+    std::thread runner([&loop]() { loop.run(); });
+    std::printf("backend: %s\n", loop.backend());
+    const std::vector<std::pair<const char*, void (*)(EventLoop&)>> tests = {
+            {"splitChunkHeaders", splitChunkHeaders},
+            {"trailers", trailers},
+            {"closedMidBody", closedMidBody},
+            {"reusedSocketDies", reusedSocketDies},
+    };
+    for (const auto& test : tests) {
+        int before = failures;
+        test.second(loop);
+        std::printf("%s %s\n", before == failures ? "ok  " : "FAIL", test.first);
+    }
+    loop.stop();
+    runner.join();
+    return failures ? 1 : 0;
+}
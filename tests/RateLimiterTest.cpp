@@ -0,0 +1,86 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "RateLimiter.hpp"
+
+/*
+ * Every priority has to spend a bucket at the configured rate, whatever share of it the priority keeps in
+ * reserve and whatever an operation costs. Each case drains a bucket of its own, then counts what a priority
+ * gets through it over a fixed window.
+ */
+
+static const double RATE = 50;
+static const double WARMUP_SECONDS = 0.2;
+static const double WINDOW_SECONDS = 0.5;
+// how far the measured rate may stray from the configured one
+static const double TOLERANCE = 0.2;
+
+static int failures = 0;
+
+static void expect(bool ok, const char* test, const std::string& what) {
+    if (ok) return;
+    failures++;
+    std::printf("FAIL %s: %s\n", test, what.c_str());
+}
+
+// tokens per second priority spends from a fresh bucket of burst, on an operation of cost
+static double measure(Priority priority, double burst, double cost) {
+    static int buckets = 0;
+    const std::string provider = "test" + std::to_string(buckets++);
+    RateLimiter::setKeyRate(provider, RATE, burst);
+    RateLimiter::setCost(provider, "op", cost);
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&start]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+    /* the bucket starts full, only what comes after the burst shows the rate */
+    while (elapsed() < WARMUP_SECONDS) RateLimiter::acquire(provider, "key", "op", priority);
+    start = std::chrono::steady_clock::now();
+    int granted = 0;
+    while (elapsed() < WINDOW_SECONDS) {
+        if (RateLimiter::acquire(provider, "key", "op", priority)) granted++;
+    }
+    return granted * cost / elapsed();
+}
+
+static void ratePerPriority() {
+    const std::vector<std::pair<double, double>> shapes = {{RATE, 1}, {1, 1}, {1, 2}, {RATE, 2}};
+    for (Priority priority : {Priority::BACKGROUND, Priority::LOW, Priority::NORMAL, Priority::HIGH, Priority::URGENT}) {
+        for (const auto& [burst, cost] : shapes) {
+            double rate = measure(priority, burst, cost);
+            expect(std::fabs(rate - RATE) <= RATE * TOLERANCE, __func__,
+                   std::string(Priorities::name(priority)) + " with burst " + std::to_string(burst) + " and cost "
+                   + std::to_string(cost) + " spent " + std::to_string(rate) + " tokens/s instead of "
+                   + std::to_string(RATE));
+        }
+    }
+}
+
+static void refundReturnsCharge() {
+    TokenBucket bucket(0.001, 5);
+    bucket.take(2, Priorities::reserve(Priority::BACKGROUND));
+    bucket.refund(2);
+    expect(std::fabs(bucket.available() - 5) < 0.01, __func__, "full bucket left at " + std::to_string(bucket.available()));
+
+    /* a cost beyond the whole bucket leaves it in debt, and the refund pays back exactly that */
+    TokenBucket small(0.001, 1);
+    small.take(3);
+    expect(small.available() < -1.9, __func__, "cost 3 on a bucket of 1 left " + std::to_string(small.available()));
+    small.refund(3);
+    expect(std::fabs(small.available() - 1) < 0.01, __func__, "refund left " + std::to_string(small.available()));
+}
+
+int main() {
+    const std::vector<std::pair<const char*, void (*)()>> tests = {
+            {"ratePerPriority", ratePerPriority},
+            {"refundReturnsCharge", refundReturnsCharge},
+    };
+    for (const auto& test : tests) {
+        int before = failures;
+        test.second();
+        std::printf("%s %s\n", before == failures ? "ok  " : "FAIL", test.first);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Scheduler.hpp"
+
+/*
+ * However wide the jitter, a target is never polled again sooner than the minimum interval or later than the
+ * maximum. Targets run through the real scheduler and work queue, seeing activity on some polls and none on
+ * others so their intervals move between both ends, and the gap between each target's consecutive polls is
+ * checked against the bounds.
+ */
+
+static const std::chrono::milliseconds MIN_INTERVAL(10);
+static const std::chrono::milliseconds MAX_INTERVAL(40);
+static const double JITTER = 0.9;
+static const size_t TARGETS = 20;
+static const size_t WORKERS = 4;
+static const std::chrono::milliseconds RUN_FOR(1500);
+// how late a poll may start after its due time, for the scheduler and a worker to get to it
+static const std::chrono::milliseconds LATENESS(20);
+
+static int failures = 0;
+
+static void expect(bool ok, const char* test, const std::string& what) {
+    if (ok) return;
+    failures++;
+    std::printf("FAIL %s: %s\n", test, what.c_str());
+}
+
+static void jitterStaysWithinBounds() {
+    using Clock = Scheduler::Clock;
+    auto queue = std::make_shared<WorkQueue>();
+    std::mutex mutex;
+    std::vector<std::vector<Clock::time_point>> polls(TARGETS);
+    std::mt19937 activity_source(std::random_device{}());
+    Scheduler scheduler(queue, [&](size_t target) {
+        std::lock_guard<std::mutex> lock(mutex);
+        polls[target].push_back(Clock::now());
+        /* mostly idle, so intervals climb to the maximum between the polls that drop them back */
+        return 0 == activity_source() % 4;
+    }, [](size_t) { return Priority::NORMAL; }, Scheduler::Backoff{MIN_INTERVAL, MIN_INTERVAL, MAX_INTERVAL, JITTER});
+    scheduler.addTargets(TARGETS);
+
+    std::atomic<bool> active{true};
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < WORKERS; ++i) {
+        workers.emplace_back([&queue]() {
+            WorkQueue::Task task;
+            while (queue->pop(task)) task();
+        });
+    }
+    std::thread runner([&]() { scheduler.run(active); });
+    std::this_thread::sleep_for(RUN_FOR);
+    active = false;
+    runner.join();
+    queue->shutdown();
+    for (std::thread& worker : workers) worker.join();
+
+    size_t gaps = 0;
+    auto shortest = std::chrono::milliseconds::max();
+    auto longest = std::chrono::milliseconds::zero();
+    for (const auto& times : polls) {
+        for (size_t i = 1; i < times.size(); ++i) {
+            auto gap = std::chrono::duration_cast<std::chrono::milliseconds>(times[i] - times[i - 1]);
+            shortest = std::min(shortest, gap);
+            longest = std::max(longest, gap);
+            gaps++;
+        }
+    }
+    expect(gaps >= TARGETS * 10, __func__, "only " + std::to_string(gaps) + " reschedules");
+    expect(shortest >= MIN_INTERVAL, __func__,
+           "polled again after " + std::to_string(shortest.count()) + "ms, under the minimum");
+    expect(longest <= MAX_INTERVAL + LATENESS, __func__,
+           "polled again after " + std::to_string(longest.count()) + "ms, over the maximum");
+}
+
+int main() {
+    const std::vector<std::pair<const char*, void (*)()>> tests = {
+            {"jitterStaysWithinBounds", jitterStaysWithinBounds},
+    };
+    for (const auto& test : tests) {
+        int before = failures;
+        test.second();
+        std::printf("%s %s\n", before == failures ? "ok  " : "FAIL", test.first);
+    }
+    return failures ? 1 : 0;
+}